@@ -1,15 +1,28 @@
 #include "button.h"
 
 #include <esp_check.h>
-#include <esp_timer.h>
+#include <esp_attr.h>
 #include <freertos/semphr.h>
-#include <driver/gpio.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "ebtn_hal.h"
+#include "ebtn_ring.h"
+#include "ebtn_rate.h"
+#include "ebtn_prepoll.h"
+#include "ebtn_registry.h"
+#include "ebtn_sched.h"
+#include "ebtn_snapshot.h"
+#include "ebtn_stats.h"
 
 static const char* TAG = "ebtn-button";
 
+// lock wait, a poll of the engine can hold up add/remove for about one of its intervals
+#define MUTEX_TIMEOUT(engine) (pdMS_TO_TICKS(((engine)->interval_us + 999U) / 1000U) + 1)
+
 #define SEMAPHORE_TAKE()                                                                                                                                       \
    do {                                                                                                                                                        \
-      if (!xSemaphoreTake(mutex, pdMS_TO_TICKS(CONFIG_EBTN_POLLING_INTERVAL_MS_BTN))) {                                                                        \
+      if (!xSemaphoreTake(engine->mutex, MUTEX_TIMEOUT(engine))) {                                                                                             \
          ESP_LOGE(TAG, "Could not take mutex");                                                                                                                \
          return ESP_ERR_TIMEOUT;                                                                                                                               \
       }                                                                                                                                                        \
@@ -17,219 +30,1027 @@ static const char* TAG = "ebtn-button";
 
 #define SEMAPHORE_GIVE()                                                                                                                                       \
    do {                                                                                                                                                        \
-      if (!xSemaphoreGive(mutex)) {                                                                                                                            \
+      if (!xSemaphoreGive(engine->mutex)) {                                                                                                                    \
          ESP_LOGE(TAG, "Could not give mutex");                                                                                                                \
          return ESP_FAIL;                                                                                                                                      \
       }                                                                                                                                                        \
    } while (0)
 
-static uint32_t time_ms = 0;
+struct button_engine {
+   int64_t now_us;   // time of the current poll
+   ebtn_time_t time; // now_us in milliseconds, or in ticks with CONFIG_EBTN_COMPACT, wrapping
+#if CONFIG_EBTN_COMPACT
+   uint32_t swept; // ticks at the last age sweep
+#endif
 
-static button_t* buttons[CONFIG_EBTN_MAX_COUNT_BTN] = {NULL};
-static button_t* lastPressed[CONFIG_EBTN_MAX_COUNT_BTN_GROUPS] = {NULL};
+   button_t* last_pressed[CONFIG_EBTN_MAX_COUNT_BTN_GROUPS];
 
-static esp_timer_handle_t timer;
-static QueueHandle_t _queue;
-static SemaphoreHandle_t mutex;
+   // read by poll() without locking, the mutex only serializes add/remove
+   ebtn_epoch_t epoch;
+   ebtn_registry_t buttons;
+   ebtn_registry_t ports;
 
-static ebtn_prepoll_cb_t _prepoll_callback = NULL;
+   ebtn_hal_timer_t timer; // NULL if polled from the shared timer
+   uint32_t interval_us;
+   QueueHandle_t queue;
+   SemaphoreHandle_t mutex;
 
-inline static void poll_button(button_t* btn) {
-   if (!btn->poll_state_callback)
+   button_event_cb_t event_callback;
+   ebtn_prepoll_cb_t prepoll_callback;
+   ebtn_prepoll_async_t* prepoll_async;
+
+#if CONFIG_EBTN_EVENT_RING
+   button_event_t ring_buf[1 << CONFIG_EBTN_EVENT_RING_ORDER_BTN];
+   button_event_t ring_overflow;
+   ebtn_ring_t ring;
+   TaskHandle_t consumer;
+   bool ring_pushed; // events were pushed during the current poll
+#endif
+
+#if CONFIG_EBTN_STATS
+   int64_t next_poll_us; // scheduled time of the next poll, 0 if unknown
+#endif
+
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   atomic_bool idle; // true while the polling timer is stopped waiting for an edge
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   ebtn_rate_t rate;
+   portMUX_TYPE rate_lock;
+#endif
+
+   _Atomic(void*) slots[]; // registry arrays of created engines, unless dynamic
+};
+
+// engine of the global API
+static button_engine_t default_engine;
+EBTN_REGISTRY_STORAGE(button_slots, CONFIG_EBTN_MAX_COUNT_BTN);
+EBTN_REGISTRY_STORAGE(port_slots, CONFIG_EBTN_MAX_COUNT_BTN_PORTS);
+
+#if CONFIG_EBTN_COMPACT
+// events carry the id of the button instead of a pointer to it, and times in ticks
+#define EVENT_SENDER(btn) .id = (btn)->id
+#define EVENT_TIMESTAMP(engine) .timestamp_ticks = (engine)->time
+#define EVENT_DELTA delta_ticks
+#define SAME_SENDER(a, b) ((a)->id == (b)->id)
+#else
+#define EVENT_SENDER(btn) .sender = (btn)
+#define EVENT_TIMESTAMP(engine) .timestamp_us = (engine)->now_us
+#define EVENT_DELTA delta_ms
+#define SAME_SENDER(a, b) ((a)->sender == (b)->sender)
+#endif
+
+#if CONFIG_EBTN_EVENT_RING
+static bool merge_event(void* dst, const void* src) {
+   button_event_t* a = dst;
+   const button_event_t* b = src;
+
+   if (!SAME_SENDER(a, b) || a->type != b->type)
+      return false;
+
+   *a = *b; // keep the latest count and delta
+   return true;
+}
+#endif
+
+// returns false if the event was dropped
+inline static bool push_event(button_engine_t* engine, button_t* btn, const button_event_t* evt) {
+   const button_event_cb_t callback = btn->event_callback ? btn->event_callback : engine->event_callback;
+   if (callback) {
+      callback(evt);
+      return true;
+   }
+
+#if CONFIG_EBTN_EVENT_RING
+   if (!engine->queue) {
+      const bool pushed = ebtn_ring_push(&engine->ring, evt);
+      engine->ring_pushed |= pushed;
+      return pushed;
+   }
+#endif
+   return xQueueSendToBack(engine->queue, evt, 0) == pdTRUE;
+}
+
+inline static void send_event(button_engine_t* engine, button_t* btn, const button_event_t* evt) {
+   const uint8_t mask = btn->event_mask;
+   if (mask && !(mask & BUTTON_EVENT_BIT(evt->type))) {
+#if CONFIG_EBTN_STATS
+      btn->internal.events_filtered++;
+      ebtn_stats_filtered(&ebtn_stats.buttons, evt->type);
+#endif
       return;
+   }
 
-   const uint8_t pressed = btn->poll_state_callback(btn->pin) ^ btn->active_low;
-   const uint32_t delta = time_ms - btn->internal.last_changed_ms; // milliseconds since button state changed
+   const bool sent = push_event(engine, btn, evt);
 
-   button_event_t evt = {.sender = btn, .delta_ms = 0, .count = 1};
+#if CONFIG_EBTN_STATS
+   ebtn_stats_event(&ebtn_stats.buttons, evt->type, sent);
+   if (sent) {
+      btn->internal.events_sent++;
+   } else {
+      btn->internal.events_dropped++;
+   }
+#else
+   (void)sent;
+#endif
+}
+
+#if CONFIG_EBTN_STATS
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+#define PERIOD_US(engine) ((engine)->rate.period_us)
+#else
+#define PERIOD_US(engine) ((engine)->interval_us)
+#endif
+#endif
+
+#if CONFIG_EBTN_PORT_MASK_64
+#define MASK_BIT(n) (1ULL << (n))
+#define MASK_CTZ(m) __builtin_ctzll(m)
+#else
+#define MASK_BIT(n) (1UL << (n))
+#define MASK_CTZ(m) __builtin_ctzl(m)
+#endif
+
+#if CONFIG_EBTN_COMPACT
+// 16-bit tick times can't tell a long state from a wrapped one, so ages are clamped before they can wrap (see sweep())
+#define AGE_MAX 0x8000U     // ages from here on are saturated
+#define SWEEP_TICKS 0x1000U // ages grow by less than this between sweeps
+
+#define TIME_OF_US(us) ((ebtn_time_t)ebtn_hal_ticks(us))
+#define TIME_OF_MS(ms) (((ms) + EBTN_TICK_MS - 1) / EBTN_TICK_MS)
+#else
+#define TIME_OF_US(us) ((ebtn_time_t)((us) / 1000))
+#define TIME_OF_MS(ms) (ms)
+#endif
+
+#if CONFIG_EBTN_BTN_TIMING_PROFILES
+#define CLICK_MAX_MS(btn) ((btn)->timing ? (btn)->timing->click_max_ms : CONFIG_EBTN_CLICK_MAX_MS)
+#define LONG_PRESS_MIN_MS(btn) ((btn)->timing ? (btn)->timing->long_press_min_ms : CONFIG_EBTN_LONG_PRESS_MIN_MS)
+#else
+#define CLICK_MAX_MS(btn) CONFIG_EBTN_CLICK_MAX_MS
+#define LONG_PRESS_MIN_MS(btn) CONFIG_EBTN_LONG_PRESS_MIN_MS
+#endif
+
+// time since a button time, saturated with CONFIG_EBTN_COMPACT
+inline static ebtn_time_t elapsed(button_engine_t* engine, ebtn_time_t since) {
+   const ebtn_time_t age = engine->time - since;
+#if CONFIG_EBTN_COMPACT
+   return age < AGE_MAX ? age : EBTN_TICKS_SATURATED;
+#else
+   return age;
+#endif
+}
+
+// returns true while the button still needs polling (held, or consecutive clicks pending)
+inline static bool process_button(button_engine_t* engine, button_t* btn, uint8_t pressed) {
+   const ebtn_time_t delta = elapsed(engine, btn->internal.last_changed); // time since button state changed
+
+   button_event_t evt = {EVENT_SENDER(btn), .EVENT_DELTA = 0, .count = 1, EVENT_TIMESTAMP(engine)};
 
    if (btn->internal.state != pressed) { // button state changed (released -> pressed, or pressed -> released)
       btn->internal.state = pressed;
-      btn->internal.last_changed_ms = time_ms;
+      btn->internal.last_changed = engine->time;
+
+#if CONFIG_EBTN_SNAPSHOT
+      ebtn_snapshot_set_pressed(btn->id, pressed);
+#endif
 
       if (!btn->internal.state) { // released transition (pressed -> released)
 
          evt.type = BUTTON_RELEASED;
-         evt.delta_ms = delta;
-         xQueueSendToBack(_queue, &evt, 0);
+         evt.EVENT_DELTA = delta;
+         send_event(engine, btn, &evt);
 
-         if (delta < CONFIG_EBTN_CLICK_MAX_MS) { // button was tapped
+         if (delta < TIME_OF_MS(CLICK_MAX_MS(btn))) { // button was tapped
             btn->internal.click_count++;         // increment consecutive click counter
-            btn->internal.previous_delta_ms = delta;
+            btn->internal.previous_delta = delta;
 
-         } else if (btn->internal.long_press_pending && lastPressed[btn->group] == btn) { // slow press->release
-                                                                                          // fire event immediately, since button was held for awhile
+         } else if (btn->internal.long_press_pending && engine->last_pressed[btn->group] == btn) { // slow press->release
+                                                                                                  // fire event immediately, since button was held for awhile
             evt.type = BUTTON_CLICKED;
-            evt.delta_ms = delta;
-            xQueueSendToBack(_queue, &evt, 0);
+            evt.EVENT_DELTA = delta;
+            send_event(engine, btn, &evt);
 
             btn->internal.click_count = 0;
          }
 
       } else { // pressed transition (released -> pressed)
          evt.type = BUTTON_PRESSED;
-         evt.delta_ms = delta;
-         xQueueSendToBack(_queue, &evt, 0);
+         evt.EVENT_DELTA = delta;
+         send_event(engine, btn, &evt);
 
-         lastPressed[btn->group] = btn;
+         engine->last_pressed[btn->group] = btn;
          btn->internal.long_press_pending = true;
       }
    } else if (btn->internal.state) { // pressed
 
       // if button is held for >EBTN_LONG_PRESS_MIN_MS fire long pressed event
-      if (delta > CONFIG_EBTN_LONG_PRESS_MIN_MS && btn->internal.long_press_pending) {
+      if (delta > TIME_OF_MS(LONG_PRESS_MIN_MS(btn)) && btn->internal.long_press_pending) {
          evt.type = BUTTON_PRESSED_LONG;
          evt.count = btn->internal.click_count + 1;
-         xQueueSendToBack(_queue, &evt, 0);
+         send_event(engine, btn, &evt);
 
          btn->internal.long_press_pending = false;
       }
 
-   } else if (delta > CONFIG_EBTN_CLICK_MAX_MS && btn->internal.click_count > 0) {
+   } else if (delta > TIME_OF_MS(CLICK_MAX_MS(btn)) && btn->internal.click_count > 0) {
       // when button is released and after CLICK_MAX_MS, process any recorded consecutive fast clicks (e.g. double or triple clicks)
-      if (btn->internal.long_press_pending && lastPressed[btn->group] == btn) {
+      if (btn->internal.long_press_pending && engine->last_pressed[btn->group] == btn) {
          evt.type = BUTTON_CLICKED;
          evt.count = btn->internal.click_count;
-         evt.delta_ms = (evt.count == 1) ? btn->internal.previous_delta_ms : 0;
-         xQueueSendToBack(_queue, &evt, 0);
+         evt.EVENT_DELTA = (evt.count == 1) ? btn->internal.previous_delta : 0;
+         send_event(engine, btn, &evt);
       }
 
       btn->internal.click_count = 0;
    }
+
+   return btn->internal.state || btn->internal.click_count;
 }
 
-static void poll(void* arg) {
-   if (_prepoll_callback)
-      _prepoll_callback();
+// returns the debounced state of a raw sample
+inline static uint8_t debounce(button_engine_t* engine, button_t* btn, uint8_t raw) {
+   const uint16_t window_ms = btn->debounce_ms ? btn->debounce_ms : CONFIG_EBTN_BTN_DEBOUNCE_MS;
+   if (!window_ms)
+      return raw;
+
+   if (raw == btn->internal.state) {
+      if (btn->internal.debouncing) { // reverted before the window passed
+         btn->internal.debouncing = false;
+#if CONFIG_EBTN_STATS
+         btn->internal.bounces++;
+#endif
+      }
+      return raw;
+   }
+
+   if (!btn->internal.debouncing) {
+      btn->internal.debouncing = true;
+      btn->internal.debounce_since = engine->time;
+      return btn->internal.state;
+   }
+
+   if (elapsed(engine, btn->internal.debounce_since) < TIME_OF_MS(window_ms))
+      return btn->internal.state;
+
+   btn->internal.debouncing = false;
+   return raw;
+}
+
+inline static bool poll_button(button_engine_t* engine, button_t* btn) {
+   if (!btn->poll_state_callback)
+      return false;
+
+   const bool busy = process_button(engine, btn, debounce(engine, btn, btn->poll_state_callback(btn->pin) ^ btn->active_low));
+   return busy || btn->internal.debouncing;
+}
+
+inline static ebtn_mask_t read_port(button_port_t* port) {
+   return port->poll_port_callback(port->port, port->ctx) ^ __atomic_load_n(&port->internal.invert, __ATOMIC_RELAXED);
+}
+
+inline static bool poll_port(button_engine_t* engine, button_port_t* port) {
+   const ebtn_mask_t used = __atomic_load_n(&port->internal.used, __ATOMIC_ACQUIRE);
+
+   // pins added since the last poll start released, the rest of the port state is only ever touched here
+   const ebtn_mask_t reset = __atomic_exchange_n(&port->internal.reset, 0, __ATOMIC_ACQUIRE);
+   if (reset) {
+      port->internal.state &= ~reset;
+      port->internal.busy &= ~reset;
+      port->internal.cnt0 |= reset;
+      port->internal.cnt1 |= reset;
+   }
+
+   const ebtn_mask_t raw = read_port(port);
+   ebtn_mask_t changed = raw ^ port->internal.state;
+
+   if (port->debounce) {
+#if CONFIG_EBTN_STATS
+      // counters are 11 at rest, so pins with a partial count that no longer differ were bounces
+      ebtn_mask_t bounced = ~(port->internal.cnt0 & port->internal.cnt1) & ~changed & used;
+#endif
+
+      // 2-bit vertical counters, a pin only toggles after differing from the debounced state for 4 consecutive polls
+      port->internal.cnt0 = ~(port->internal.cnt0 & changed);
+      port->internal.cnt1 = port->internal.cnt0 ^ (port->internal.cnt1 & changed);
+      changed &= port->internal.cnt0 & port->internal.cnt1;
+
+#if CONFIG_EBTN_STATS
+      while (bounced) {
+         button_t* btn = __atomic_load_n(&port->internal.buttons[MASK_CTZ(bounced)], __ATOMIC_RELAXED);
+         bounced &= bounced - 1;
+
+         if (btn)
+            btn->internal.bounces++;
+      }
+#endif
+   }
+
+   port->internal.state ^= changed;
+
+   // only run the state machine for pins that changed, or that have timing pending
+   ebtn_mask_t pending = (changed | port->internal.busy) & used;
+   port->internal.busy = 0;
+
+   while (pending) {
+      const uint8_t pin = MASK_CTZ(pending);
+      pending &= pending - 1;
+
+      button_t* btn = __atomic_load_n(&port->internal.buttons[pin], __ATOMIC_ACQUIRE);
+      if (btn && process_button(engine, btn, (port->internal.state >> pin) & 1))
+         port->internal.busy |= MASK_BIT(pin);
+   }
+
+   return port->internal.busy != 0;
+}
 
-   if (!xSemaphoreTake(mutex, 0))
+#if CONFIG_EBTN_COMPACT
+inline static void clamp_age(button_engine_t* engine, button_t* btn, bool saturate) {
+   if (saturate || (ebtn_time_t)(engine->time - btn->internal.last_changed) > AGE_MAX)
+      btn->internal.last_changed = engine->time - AGE_MAX;
+   // a window still debouncing after a gap has long passed, and must not look like it just started
+   if (saturate || (ebtn_time_t)(engine->time - btn->internal.debounce_since) > AGE_MAX)
+      btn->internal.debounce_since = engine->time - AGE_MAX;
+}
+
+// Clamps the age of every button to AGE_MAX every SWEEP_TICKS, so none can reach the 16-bit range. After a gap of AGE_MAX
+// ticks or more without polls (paused or idle), ages can no longer be told apart and are all saturated.
+static void sweep(button_engine_t* engine, uint32_t ticks) {
+   const uint32_t gap = ticks - engine->swept;
+   if (gap < SWEEP_TICKS)
       return;
 
-   time_ms += CONFIG_EBTN_POLLING_INTERVAL_MS_BTN;
+   engine->swept = ticks;
+   const bool saturate = gap >= AGE_MAX;
+
+   uint16_t count = ebtn_registry_count(&engine->buttons);
+   _Atomic(void*)* items = ebtn_registry_items(&engine->buttons);
+   for (uint16_t i = 0; i < count; i++)
+      clamp_age(engine, ebtn_registry_get(items, i), saturate);
+
+   count = ebtn_registry_count(&engine->ports);
+   items = ebtn_registry_items(&engine->ports);
+   for (uint16_t i = 0; i < count; i++) {
+      button_port_t* port = ebtn_registry_get(items, i);
 
-   for (uint8_t i = 0; i < CONFIG_EBTN_MAX_COUNT_BTN; i++) {
-      if (buttons[i])
-         poll_button(buttons[i]);
+      ebtn_mask_t used = __atomic_load_n(&port->internal.used, __ATOMIC_ACQUIRE);
+      while (used) {
+         button_t* btn = __atomic_load_n(&port->internal.buttons[MASK_CTZ(used)], __ATOMIC_ACQUIRE);
+         used &= used - 1;
+
+         if (btn)
+            clamp_age(engine, btn, saturate);
+      }
    }
+}
+#endif
 
-   xSemaphoreGive(mutex);
+
+#if CONFIG_EBTN_UNIFIED_TIMER
+#define SHARED_TIMER(engine) ((engine) == &default_engine) // the global API polls from the shared timer
+#else
+#define SHARED_TIMER(engine) false
+#endif
+
+static esp_err_t timer_start(button_engine_t* engine) {
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (SHARED_TIMER(engine))
+      return ebtn_sched_start(EBTN_SCHED_BUTTONS);
+#endif
+   return ebtn_hal_timer_start_periodic(engine->timer, engine->interval_us);
 }
 
-static const esp_timer_create_args_t timer_args = {
-    .arg = NULL,
-    .name = "poll_buttons",
-    .dispatch_method = ESP_TIMER_TASK,
-    .callback = poll,
-};
+static esp_err_t timer_stop(button_engine_t* engine) {
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (SHARED_TIMER(engine))
+      return ebtn_sched_stop(EBTN_SCHED_BUTTONS);
+#endif
+   return ebtn_hal_timer_stop(engine->timer);
+}
 
-static uint8_t gpio_button_poll_state(gpio_num_t pin) {
-   return gpio_get_level(pin);
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+static void idle_enter(button_engine_t* engine) {
+   // stop before flagging idle, so an edge arriving in between can't be cancelled by the stop
+   ebtn_hal_timer_stop(engine->timer);
+   atomic_store(&engine->idle, true);
+
+#if CONFIG_EBTN_STATS
+   engine->next_poll_us = 0; // woken at any time
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   portENTER_CRITICAL(&engine->rate_lock);
+   ebtn_rate_stop(&engine->rate, ebtn_hal_time_us());
+   portEXIT_CRITICAL(&engine->rate_lock);
+#endif
+
+   // catch any edge that happened after the last sample but before the timer stopped
+   uint16_t count = ebtn_registry_count(&engine->buttons);
+   _Atomic(void*)* items = ebtn_registry_items(&engine->buttons);
+   for (uint16_t i = 0; i < count; i++) {
+      button_t* btn = ebtn_registry_get(items, i);
+      if (btn->poll_state_callback && (btn->poll_state_callback(btn->pin) ^ btn->active_low) != btn->internal.state) {
+         button_engine_wake(engine);
+         return;
+      }
+   }
+
+   count = ebtn_registry_count(&engine->ports);
+   items = ebtn_registry_items(&engine->ports);
+   for (uint16_t i = 0; i < count; i++) {
+      button_port_t* port = ebtn_registry_get(items, i);
+      if ((read_port(port) ^ port->internal.state) & __atomic_load_n(&port->internal.used, __ATOMIC_RELAXED)) {
+         button_engine_wake(engine);
+         return;
+      }
+   }
 }
 
-esp_err_t button_init(QueueHandle_t queue) {
-   ESP_RETURN_ON_FALSE(queue, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+static void IRAM_ATTR gpio_isr(void* arg) {
+   button_engine_wake(arg);
+}
+#endif
 
-   _queue = queue;
-   time_ms = 0;
+static void poll(void* arg) {
+   button_engine_t* engine = arg;
 
-   mutex = xSemaphoreCreateMutex();
-   ESP_RETURN_ON_FALSE(mutex, ESP_ERR_NO_MEM, TAG, "Failed to create mutex");
+#if CONFIG_EBTN_STATS
+   const int64_t dispatch_us = ebtn_hal_time_us();
+#endif
 
-   ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &timer), TAG, "Failed to create button timer");
+   if (engine->prepoll_callback)
+      engine->prepoll_callback();
+   if (engine->prepoll_async)
+      ebtn_prepoll_async_tick(engine->prepoll_async);
 
-   return button_start();
+   ebtn_epoch_enter(&engine->epoch);
+
+   // timed from the clock rather than by counting ticks, so late or skipped polls don't stretch click and long press windows
+   engine->now_us = ebtn_hal_time_us();
+   engine->time = TIME_OF_US(engine->now_us);
+#if CONFIG_EBTN_COMPACT
+   sweep(engine, ebtn_hal_ticks(engine->now_us));
+#endif
+
+   bool busy = false;
+   uint16_t count = ebtn_registry_count(&engine->buttons);
+   _Atomic(void*)* items = ebtn_registry_items(&engine->buttons);
+   void* seen = NULL;
+   for (uint16_t i = 0; i < count; i++) {
+      button_t* btn = ebtn_registry_next(&engine->buttons, items, i, &seen);
+      if (btn)
+         busy |= poll_button(engine, btn);
+   }
+
+   count = ebtn_registry_count(&engine->ports);
+   items = ebtn_registry_items(&engine->ports);
+   seen = NULL;
+   for (uint16_t i = 0; i < count; i++) {
+      button_port_t* port = ebtn_registry_next(&engine->ports, items, i, &seen);
+      if (port)
+         busy |= poll_port(engine, port);
+   }
+
+#if CONFIG_EBTN_EVENT_RING
+   if (!engine->queue) {
+      // a held back event published by the flush is news to the consumer as well
+      engine->ring_pushed |= ebtn_ring_flush(&engine->ring);
+
+      // one notification per poll instead of one per event
+      TaskHandle_t consumer = engine->consumer;
+      if (engine->ring_pushed && consumer)
+         xTaskNotifyGive(consumer);
+      engine->ring_pushed = false;
+   }
+#endif
+
+#if CONFIG_EBTN_STATS
+   ebtn_stats_poll(&ebtn_stats.buttons, &engine->next_poll_us, dispatch_us, PERIOD_US(engine));
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   portENTER_CRITICAL(&engine->rate_lock);
+   const uint32_t period_us = ebtn_rate_update(&engine->rate, engine->now_us, busy);
+   portEXIT_CRITICAL(&engine->rate_lock);
+
+   if (period_us) {
+      ebtn_hal_timer_restart(engine->timer, period_us);
+#if CONFIG_EBTN_STATS
+      engine->next_poll_us = 0; // restarting starts a new schedule
+#endif
+   }
+#endif
+
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   if (!busy)
+      idle_enter(engine);
+#endif
+
+   ebtn_epoch_exit(&engine->epoch);
 }
 
-esp_err_t button_free() {
+static esp_err_t engine_init(button_engine_t* engine, const button_engine_config_t* config, _Atomic(void*)* button_storage, _Atomic(void*)* port_storage) {
+#if CONFIG_EBTN_EVENT_RING
+   ebtn_ring_init(&engine->ring, engine->ring_buf, &engine->ring_overflow, sizeof(button_event_t), 1 << CONFIG_EBTN_EVENT_RING_ORDER_BTN, merge_event);
+#else
+   ESP_RETURN_ON_FALSE(config->queue, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+#endif
+
+   engine->queue = config->queue;
+   engine->interval_us = config->interval_us ? config->interval_us : CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000;
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (SHARED_TIMER(engine))
+      engine->interval_us = EBTN_SCHED_BTN_TICKS * CONFIG_EBTN_POLLING_INTERVAL_US_ENC;
+#endif
+#if CONFIG_EBTN_COMPACT
+   engine->swept = ebtn_hal_ticks(ebtn_hal_time_us());
+#endif
+
+   const uint16_t max_buttons = config->max_buttons ? config->max_buttons : CONFIG_EBTN_MAX_COUNT_BTN;
+   const uint16_t max_ports = config->max_ports ? config->max_ports : CONFIG_EBTN_MAX_COUNT_BTN_PORTS;
+
+   esp_err_t ret = ESP_OK;
+#if CONFIG_EBTN_UNIFIED_TIMER
+   bool scheduled = false;
+#endif
+   ESP_GOTO_ON_ERROR(ebtn_registry_init(&engine->buttons, button_storage, max_buttons, offsetof(button_t, internal.index), &engine->epoch), err, TAG,
+                     "Failed to create button registry");
+   ESP_GOTO_ON_ERROR(ebtn_registry_init(&engine->ports, port_storage, max_ports, offsetof(button_port_t, internal.index), &engine->epoch), err, TAG,
+                     "Failed to create port registry");
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   const uint32_t idle_us = CONFIG_EBTN_POLLING_IDLE_INTERVAL_MS_BTN * 1000;
+   portMUX_INITIALIZE(&engine->rate_lock);
+   ebtn_rate_init(&engine->rate, engine->interval_us, idle_us > engine->interval_us ? idle_us : engine->interval_us, CONFIG_EBTN_ADAPTIVE_QUIET_MS * 1000);
+#endif
+
+   engine->mutex = xSemaphoreCreateMutex();
+   ESP_GOTO_ON_FALSE(engine->mutex, ESP_ERR_NO_MEM, err, TAG, "Failed to create mutex");
+
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (SHARED_TIMER(engine)) {
+      ESP_GOTO_ON_ERROR(ebtn_sched_attach(EBTN_SCHED_BUTTONS), err, TAG, "Failed to create shared timer");
+      scheduled = true;
+   } else
+#endif
+   {
+#if CONFIG_EBTN_POLL_TASK
+      static const ebtn_task_config_t default_task = EBTN_TASK_CONFIG_DEFAULT;
+      const ebtn_task_config_t* task = config->task ? config->task : &default_task;
+      ESP_GOTO_ON_ERROR(ebtn_hal_timer_create_task("poll_buttons", poll, engine, task, &engine->timer), err, TAG, "Failed to create button task");
+#else
+      ESP_GOTO_ON_ERROR(ebtn_hal_timer_create("poll_buttons", poll, engine, &engine->timer), err, TAG, "Failed to create button timer");
+#endif
+   }
+
+   ESP_GOTO_ON_ERROR(button_engine_start(engine), err, TAG, "Failed to start button polling");
+   return ESP_OK;
+
+err:
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (scheduled)
+      ebtn_sched_detach(EBTN_SCHED_BUTTONS);
+#endif
+   if (engine->timer)
+      ebtn_hal_timer_delete(engine->timer);
+   engine->timer = NULL;
+   if (engine->mutex)
+      vSemaphoreDelete(engine->mutex);
+   engine->mutex = NULL;
+   ebtn_registry_deinit(&engine->buttons);
+   ebtn_registry_deinit(&engine->ports);
+   return ret;
+}
+
+// unpublishes the engine of a port leaving it, and waits for any button_port_wake() still using it
+static void port_detach(button_port_t* port) {
+   __atomic_store_n(&port->internal.engine, NULL, __ATOMIC_SEQ_CST);
+   while (__atomic_load_n(&port->internal.wakers, __ATOMIC_SEQ_CST))
+      vTaskDelay(1);
+}
+
+static esp_err_t engine_free(button_engine_t* engine) {
    SEMAPHORE_TAKE();
 
-   button_pause();
-   esp_timer_delete(timer);
-   timer = NULL;
+   button_engine_pause(engine);
+   ebtn_epoch_synchronize(&engine->epoch);
+
+   // ports still attached must not wake the engine once it is gone
+   const uint16_t count = ebtn_registry_count(&engine->ports);
+   _Atomic(void*)* items = ebtn_registry_items(&engine->ports);
+   for (uint16_t i = 0; i < count; i++)
+      port_detach(ebtn_registry_get(items, i));
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (SHARED_TIMER(engine))
+      ebtn_sched_detach(EBTN_SCHED_BUTTONS);
+#endif
+   if (engine->timer)
+      ebtn_hal_timer_delete(engine->timer);
+   engine->timer = NULL;
+   ebtn_registry_deinit(&engine->buttons);
+   ebtn_registry_deinit(&engine->ports);
 
-   _queue = NULL;
+   engine->queue = NULL;
 
    SEMAPHORE_GIVE();
 
-   vSemaphoreDelete(mutex);
+   vSemaphoreDelete(engine->mutex);
+   engine->mutex = NULL;
+   return ESP_OK;
+}
+
+esp_err_t button_init(QueueHandle_t queue) {
+   const button_engine_config_t config = {.queue = queue};
+   return engine_init(&default_engine, &config, button_slots, port_slots);
+}
+
+esp_err_t button_free() {
+   return engine_free(&default_engine);
+}
+
+esp_err_t button_engine_create(const button_engine_config_t* config, button_engine_t** out_engine) {
+   ESP_RETURN_ON_FALSE(config && out_engine, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+
+   // registry arrays follow the engine, unless the registries allocate them
+#if CONFIG_EBTN_REGISTRY_DYNAMIC
+   const size_t button_count = 0;
+   const size_t port_count = 0;
+#else
+   const size_t button_count = config->max_buttons ? config->max_buttons : CONFIG_EBTN_MAX_COUNT_BTN;
+   const size_t port_count = config->max_ports ? config->max_ports : CONFIG_EBTN_MAX_COUNT_BTN_PORTS;
+#endif
+
+   button_engine_t* engine = calloc(1, sizeof(button_engine_t) + (button_count + port_count) * sizeof(_Atomic(void*)));
+   ESP_RETURN_ON_FALSE(engine, ESP_ERR_NO_MEM, TAG, "Failed to allocate engine");
+
+   const esp_err_t err = engine_init(engine, config, button_count ? engine->slots : NULL, port_count ? engine->slots + button_count : NULL);
+   if (err != ESP_OK) {
+      free(engine);
+      return err;
+   }
+
+   *out_engine = engine;
+   return ESP_OK;
+}
+
+esp_err_t button_engine_delete(button_engine_t* engine) {
+   ESP_RETURN_ON_FALSE(engine && engine != &default_engine, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+
+   ESP_RETURN_ON_ERROR(engine_free(engine), TAG, "Failed to free engine");
+   free(engine);
    return ESP_OK;
 }
 
+esp_err_t button_engine_pause(button_engine_t* engine) {
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   portENTER_CRITICAL(&engine->rate_lock);
+   ebtn_rate_stop(&engine->rate, ebtn_hal_time_us());
+   portEXIT_CRITICAL(&engine->rate_lock);
+#endif
+
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   if (atomic_exchange(&engine->idle, false)) // timer already stopped, and edges must no longer restart it
+      return ESP_OK;
+#endif
+   return timer_stop(engine);
+}
+
+esp_err_t button_engine_start(button_engine_t* engine) {
+#if CONFIG_EBTN_STATS
+   engine->next_poll_us = 0;
+#endif
+
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   atomic_store(&engine->idle, false);
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   portENTER_CRITICAL(&engine->rate_lock);
+   ebtn_rate_start(&engine->rate, ebtn_hal_time_us());
+   portEXIT_CRITICAL(&engine->rate_lock);
+#endif
+
+   return timer_start(engine);
+}
+
 esp_err_t button_pause() {
-   return esp_timer_stop(timer);
+   return button_engine_pause(&default_engine);
 }
 
 esp_err_t button_start() {
-   return esp_timer_start_periodic(timer, CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000);
+   return button_engine_start(&default_engine);
+}
+
+#if CONFIG_EBTN_EVENT_RING
+size_t button_engine_events_drain(button_engine_t* engine, button_event_t* buf, size_t n) {
+   return ebtn_ring_pop(&engine->ring, buf, n);
+}
+
+void button_engine_events_set_consumer(button_engine_t* engine, TaskHandle_t task) {
+   engine->consumer = task;
+}
+
+uint32_t button_engine_events_dropped(button_engine_t* engine) {
+   return atomic_load_explicit(&engine->ring.dropped, memory_order_relaxed);
+}
+
+size_t button_events_drain(button_event_t* buf, size_t n) {
+   return button_engine_events_drain(&default_engine, buf, n);
+}
+
+void button_events_set_consumer(TaskHandle_t task) {
+   button_engine_events_set_consumer(&default_engine, task);
+}
+
+uint32_t button_events_dropped() {
+   return button_engine_events_dropped(&default_engine);
+}
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+void button_engine_get_rate_info(button_engine_t* engine, ebtn_rate_info_t* info) {
+   portENTER_CRITICAL(&engine->rate_lock);
+   ebtn_rate_get(&engine->rate, ebtn_hal_time_us(), info);
+   portEXIT_CRITICAL(&engine->rate_lock);
+}
+
+void button_get_rate_info(ebtn_rate_info_t* info) {
+   button_engine_get_rate_info(&default_engine, info);
+}
+#endif
+
+void IRAM_ATTR button_engine_wake(button_engine_t* engine) {
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   if (atomic_exchange(&engine->idle, false))
+      ebtn_hal_timer_start_periodic(engine->timer, engine->interval_us);
+#endif
+}
+
+void IRAM_ATTR button_port_wake(button_port_t* port) {
+   // counted, so removing the last button of the port waits until the engine is no longer used here
+   __atomic_fetch_add(&port->internal.wakers, 1, __ATOMIC_SEQ_CST);
+   button_engine_t* engine = __atomic_load_n(&port->internal.engine, __ATOMIC_SEQ_CST);
+   if (engine)
+      button_engine_wake(engine);
+   __atomic_fetch_sub(&port->internal.wakers, 1, __ATOMIC_RELEASE);
+}
+
+void IRAM_ATTR button_wake() {
+   button_engine_wake(&default_engine);
+}
+
+#if CONFIG_EBTN_UNIFIED_TIMER
+void ebtn_sched_poll_buttons() {
+   poll(&default_engine);
+}
+#endif
+
+void button_engine_set_event_callback(button_engine_t* engine, button_event_cb_t event_callback) {
+   engine->event_callback = event_callback;
+}
+
+void button_engine_set_prepoll_callback(button_engine_t* engine, ebtn_prepoll_cb_t prepoll_callback) {
+   engine->prepoll_callback = prepoll_callback;
+}
+
+void button_engine_set_prepoll_async(button_engine_t* engine, ebtn_prepoll_async_t* prepoll) {
+   engine->prepoll_async = prepoll;
+}
+
+void button_set_event_callback(button_event_cb_t event_callback) {
+   button_engine_set_event_callback(&default_engine, event_callback);
 }
 
 void button_set_prepoll_callback(ebtn_prepoll_cb_t prepoll_callback) {
-   _prepoll_callback = prepoll_callback;
+   button_engine_set_prepoll_callback(&default_engine, prepoll_callback);
 }
 
-esp_err_t button_add(button_t* btn) {
-   ESP_RETURN_ON_FALSE(btn, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+void button_set_prepoll_async(ebtn_prepoll_async_t* prepoll) {
+   button_engine_set_prepoll_async(&default_engine, prepoll);
+}
+
+static void reset_button(button_t* btn) {
+   btn->internal.state = 0;
+   btn->internal.last_changed = TIME_OF_US(ebtn_hal_time_us());
+   btn->internal.click_count = 0;
+   btn->internal.long_press_pending = true;
+   btn->internal.previous_delta = 0;
+   btn->internal.debouncing = false;
+
+#if CONFIG_EBTN_STATS
+   btn->internal.bounces = 0;
+   btn->internal.events_filtered = 0;
+   btn->internal.events_sent = 0;
+   btn->internal.events_dropped = 0;
+#endif
+}
+
+#if CONFIG_EBTN_COMPACT
+// Compact events only carry the id, so it must tell the buttons of an engine apart.
+// must be called while holding the mutex
+static bool id_in_use(button_engine_t* engine, const button_t* btn) {
+   uint16_t count = ebtn_registry_count(&engine->buttons);
+   _Atomic(void*)* items = ebtn_registry_items(&engine->buttons);
+   for (uint16_t i = 0; i < count; i++) {
+      const button_t* other = ebtn_registry_get(items, i);
+      if (other != btn && other->id == btn->id)
+         return true;
+   }
+
+   count = ebtn_registry_count(&engine->ports);
+   items = ebtn_registry_items(&engine->ports);
+   for (uint16_t i = 0; i < count; i++) {
+      const button_port_t* port = ebtn_registry_get(items, i);
+
+      ebtn_mask_t used = port->internal.used;
+      while (used) {
+         const button_t* other = port->internal.buttons[MASK_CTZ(used)];
+         used &= used - 1;
+
+         if (other != btn && other->id == btn->id)
+            return true;
+      }
+   }
+   return false;
+}
+#endif
+
+// must be called while holding the mutex
+static esp_err_t port_add_button(button_engine_t* engine, button_t* btn) {
+   button_port_t* port = btn->port;
+   const ebtn_mask_t bit = MASK_BIT(btn->pin);
+
+   if (port->internal.used & bit)
+      return port->internal.buttons[btn->pin] == btn ? ESP_ERR_INVALID_STATE : ESP_ERR_INVALID_ARG;
+
+   if (!port->internal.used) { // first button of this port, add port to the polling loop
+      port->internal.invert = 0;
+      port->internal.reset = 0;
+      port->internal.state = 0;
+      port->internal.busy = 0;
+      port->internal.cnt0 = ~(ebtn_mask_t)0;
+      port->internal.cnt1 = ~(ebtn_mask_t)0;
+
+      // polled with nothing used until the bits below are published
+      const esp_err_t err = ebtn_registry_add(&engine->ports, port);
+      if (err != ESP_OK)
+         return err;
+
+      __atomic_store_n(&port->internal.engine, engine, __ATOMIC_RELEASE);
+   }
+
+   reset_button(btn);
+
+   // publish in the order poll_port() reads: button and config first, the used bit last
+   __atomic_store_n(&port->internal.buttons[btn->pin], btn, __ATOMIC_RELEASE);
+   if (btn->active_low) {
+      __atomic_fetch_or(&port->internal.invert, bit, __ATOMIC_RELEASE);
+   } else {
+      __atomic_fetch_and(&port->internal.invert, ~bit, __ATOMIC_RELEASE);
+   }
+   __atomic_fetch_or(&port->internal.reset, bit, __ATOMIC_RELEASE);
+   __atomic_fetch_or(&port->internal.used, bit, __ATOMIC_RELEASE);
+
+   return ESP_OK;
+}
+
+// must be called while holding the mutex
+static esp_err_t port_remove_button(button_engine_t* engine, button_t* btn) {
+   button_port_t* port = btn->port;
+   const ebtn_mask_t bit = MASK_BIT(btn->pin);
+
+   if (!(port->internal.used & bit) || port->internal.buttons[btn->pin] != btn || port->internal.engine != engine)
+      return ESP_ERR_INVALID_ARG;
+
+   __atomic_fetch_and(&port->internal.used, ~bit, __ATOMIC_RELEASE);
+   __atomic_store_n(&port->internal.buttons[btn->pin], NULL, __ATOMIC_RELEASE);
+
+   if (!port->internal.used) { // last button of this port, remove port from the polling loop
+      port_detach(port);
+      return ebtn_registry_remove(&engine->ports, port);
+   }
+
+   ebtn_epoch_synchronize(&engine->epoch);
+   return ESP_OK;
+}
+
+#if CONFIG_EBTN_SNAPSHOT
+// must be called while holding the mutex
+static bool is_added(button_engine_t* engine, button_t* btn) {
+   if (btn->port)
+      return btn->port->internal.engine == engine && (btn->port->internal.used & MASK_BIT(btn->pin)) && btn->port->internal.buttons[btn->pin] == btn;
+   return ebtn_registry_contains(&engine->buttons, btn);
+}
+#endif
+
+esp_err_t button_engine_add(button_engine_t* engine, button_t* btn) {
+   ESP_RETURN_ON_FALSE(engine && btn, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
    ESP_RETURN_ON_FALSE(btn->group < CONFIG_EBTN_MAX_COUNT_BTN_GROUPS, ESP_ERR_INVALID_STATE, TAG, "Invalid button group");
+   ESP_RETURN_ON_FALSE(!btn->port || (btn->port->poll_port_callback && (unsigned)btn->pin < EBTN_MASK_BITS), ESP_ERR_INVALID_ARG, TAG,
+                       "Invalid port or port pin");
+#if CONFIG_EBTN_COMPACT
+   ESP_RETURN_ON_FALSE(btn->id, ESP_ERR_INVALID_ARG, TAG, "Button id required with CONFIG_EBTN_COMPACT");
+#endif
 
    SEMAPHORE_TAKE();
 
-   esp_err_t ret = ESP_ERR_NO_MEM;
+   esp_err_t ret = ESP_OK;
 
-   for (uint8_t i = 0; i < CONFIG_EBTN_MAX_COUNT_BTN; i++) {
-      ESP_GOTO_ON_FALSE(buttons[i] != btn, ESP_ERR_INVALID_STATE, end, TAG, "Button already added");
+#if CONFIG_EBTN_COMPACT
+   ESP_GOTO_ON_FALSE(!id_in_use(engine, btn), ESP_ERR_INVALID_ARG, end, TAG, "Button id already in use");
+#endif
 
-      if (buttons[i])
-         continue;
+#if CONFIG_EBTN_SNAPSHOT
+   // snapshots are shared by all engines, a button already added fails below and keeps its id
+   bool claimed = false;
+   if (!is_added(engine, btn)) {
+      ESP_GOTO_ON_FALSE(ebtn_snapshot_claim_pressed(btn->id), ESP_ERR_INVALID_ARG, end, TAG, "Snapshot id already in use");
+      claimed = true;
+   }
+#endif
 
-      btn->internal.state = 0;
-      btn->internal.last_changed_ms = 0;
-      btn->internal.click_count = 0;
-      btn->internal.long_press_pending = true;
-      btn->internal.previous_delta_ms = 0;
-
-      if (!btn->poll_state_callback) {
-         esp_rom_gpio_pad_select_gpio(btn->pin);
-         ret = gpio_set_direction(btn->pin, GPIO_MODE_INPUT);
-         if (ret != ESP_OK)
-            break;
-
-         if (btn->internal_pull) {
-            ret = gpio_set_pull_mode(btn->pin, btn->active_low ? GPIO_PULLUP_ONLY : GPIO_PULLDOWN_ONLY);
-            if (ret != ESP_OK)
-               break;
-         }
+   if (btn->port) {
+      ESP_GOTO_ON_FALSE(!btn->port->internal.used || btn->port->internal.engine == engine, ESP_ERR_INVALID_ARG, end, TAG, "Port polled by another engine");
 
-         btn->poll_state_callback = gpio_button_poll_state;
-      }
+      ret = port_add_button(engine, btn);
+      ESP_GOTO_ON_FALSE(ret != ESP_ERR_INVALID_STATE, ret, end, TAG, "Button already added");
+      ESP_GOTO_ON_FALSE(ret != ESP_ERR_INVALID_ARG, ret, end, TAG, "Port pin already in use");
+      goto end;
+   }
 
-      buttons[i] = btn;
-      ret = ESP_OK;
-      break;
+   ESP_GOTO_ON_FALSE(!ebtn_registry_contains(&engine->buttons, btn), ESP_ERR_INVALID_STATE, end, TAG, "Button already added");
+   ESP_GOTO_ON_FALSE(!ebtn_registry_full(&engine->buttons), ESP_ERR_NO_MEM, end, TAG, "Too many buttons");
+
+   reset_button(btn);
+
+   if (!btn->poll_state_callback) {
+      ESP_GOTO_ON_ERROR(ebtn_hal_gpio_input_init(btn->pin, btn->internal_pull, btn->active_low), end, TAG, "Failed to init button GPIO");
+      btn->poll_state_callback = ebtn_hal_gpio_get_level;
    }
 
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   if (btn->poll_state_callback == ebtn_hal_gpio_get_level)
+      ESP_GOTO_ON_ERROR(ebtn_hal_gpio_isr_add(btn->pin, gpio_isr, engine), end, TAG, "Failed to add button GPIO interrupt");
+#endif
+
+   ret = ebtn_registry_add(&engine->buttons, btn);
+
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   if (ret != ESP_OK && btn->poll_state_callback == ebtn_hal_gpio_get_level)
+      ebtn_hal_gpio_isr_remove(btn->pin);
+#endif
+
 end:
+#if CONFIG_EBTN_SNAPSHOT
+   if (ret != ESP_OK && claimed)
+      ebtn_snapshot_release_pressed(btn->id);
+#endif
+
    SEMAPHORE_GIVE();
+
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   if (ret == ESP_OK)
+      button_engine_wake(engine); // button may already be held
+#endif
+
    return ret;
 }
 
-esp_err_t button_remove(button_t* btn) {
-   ESP_RETURN_ON_FALSE(btn, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+esp_err_t button_engine_remove(button_engine_t* engine, button_t* btn) {
+   ESP_RETURN_ON_FALSE(engine && btn, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
 
    SEMAPHORE_TAKE();
 
-   esp_err_t err = ESP_ERR_INVALID_ARG;
+   esp_err_t err;
 
-   for (uint8_t i = 0; i < CONFIG_EBTN_MAX_COUNT_BTN; i++) {
-      if (buttons[i] != btn)
-         continue;
+   if (btn->port) {
+      err = port_remove_button(engine, btn);
+   } else {
+      err = ebtn_registry_remove(&engine->buttons, btn);
 
-      buttons[i] = NULL;
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+      if (err == ESP_OK && btn->poll_state_callback == ebtn_hal_gpio_get_level)
+         ebtn_hal_gpio_isr_remove(btn->pin);
+#endif
+   }
 
-      err = ESP_OK;
-      break;
+#if CONFIG_EBTN_SNAPSHOT
+   if (err == ESP_OK) { // no longer polled, so the pressed bit can't be set again
+      ebtn_snapshot_set_pressed(btn->id, false);
+      ebtn_snapshot_release_pressed(btn->id);
    }
+#endif
 
    SEMAPHORE_GIVE();
 
    return err;
-}
\ No newline at end of file
+}
+
+esp_err_t button_add(button_t* btn) {
+   return button_engine_add(&default_engine, btn);
+}
+
+esp_err_t button_remove(button_t* btn) {
+   return button_engine_remove(&default_engine, btn);
+}
@@ -0,0 +1,53 @@
+#include "button_ladder.h"
+
+#include <esp_check.h>
+
+static const char* TAG = "ebtn-ladder";
+
+#define DISTANCE(a, b) ((a) > (b) ? (a) - (b) : (b) - (a))
+
+inline static uint16_t level_of(const button_ladder_t* ladder, uint8_t index) {
+   return index < ladder->count ? ladder->levels[index] : ladder->idle_level;
+}
+
+// nearest level, only switching away from the current one once the sample is past their midpoint by the hysteresis
+static uint8_t classify(const button_ladder_t* ladder, uint16_t sample) {
+   uint8_t nearest = ladder->count;
+   uint16_t nearest_distance = DISTANCE(sample, ladder->idle_level);
+
+   for (uint8_t i = 0; i < ladder->count; i++) {
+      const uint16_t distance = DISTANCE(sample, ladder->levels[i]);
+      if (distance < nearest_distance) {
+         nearest = i;
+         nearest_distance = distance;
+      }
+   }
+
+   const uint8_t current = ladder->internal.pressed;
+   const uint32_t current_distance = DISTANCE(sample, level_of(ladder, current));
+
+   // past the midpoint by h means the current level is 2h further away than the nearest
+   return current_distance > nearest_distance + 2U * ladder->hysteresis ? nearest : current;
+}
+
+static ebtn_mask_t read_port(uint8_t port, void* ctx) {
+   button_ladder_t* ladder = ctx;
+
+   ladder->internal.sample = ladder->sample_callback(ladder);
+   ladder->internal.pressed = classify(ladder, ladder->internal.sample);
+
+   return ladder->internal.pressed < ladder->count ? (ebtn_mask_t)1 << ladder->internal.pressed : 0;
+}
+
+esp_err_t button_ladder_init(button_ladder_t* ladder) {
+   ESP_RETURN_ON_FALSE(ladder && ladder->sample_callback && ladder->levels, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+   ESP_RETURN_ON_FALSE(ladder->count && ladder->count <= EBTN_MASK_BITS, ESP_ERR_INVALID_ARG, TAG, "Invalid button count");
+
+   ladder->internal.pressed = ladder->count;
+   ladder->internal.sample = ladder->idle_level;
+
+   ladder->port.poll_port_callback = read_port;
+   ladder->port.ctx = ladder;
+
+   return ESP_OK;
+}
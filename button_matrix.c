@@ -0,0 +1,147 @@
+#include "button_matrix.h"
+
+#include <esp_check.h>
+
+#include "ebtn_hal.h"
+
+static const char* TAG = "ebtn-matrix";
+
+#define COL_MASK(matrix) ((matrix)->cols >= 32 ? UINT32_MAX : (1UL << (matrix)->cols) - 1)
+
+static void select_row(button_matrix_t* matrix, uint8_t row, bool selected) {
+   // open drain when active low, so deselected rows float instead of fighting a selected row through pressed keys
+   ebtn_hal_gpio_set_level(matrix->row_pins[row], selected ^ matrix->active_low);
+}
+
+static uint32_t read_cols(button_matrix_t* matrix) {
+   uint32_t cols = 0;
+   for (uint8_t col = 0; col < matrix->cols; col++)
+      cols |= (uint32_t)(ebtn_hal_gpio_get_level(matrix->col_pins[col]) ^ matrix->active_low) << col;
+   return cols;
+}
+
+// Without diodes, pressing three corners of a rectangle also closes the fourth, so two rows sharing two or more pressed
+// columns can't be told apart from a real combination. Those rows keep their previous state until the ambiguity clears.
+static ebtn_mask_t block_ghosts(button_matrix_t* matrix, ebtn_mask_t state) {
+   const ebtn_mask_t col_mask = COL_MASK(matrix);
+   ebtn_mask_t blocked = 0;
+
+   for (uint8_t r1 = 0; r1 < matrix->rows; r1++) {
+      const ebtn_mask_t a = (state >> (r1 * matrix->cols)) & col_mask;
+      if (!(a & (a - 1))) // fewer than two keys can't form a rectangle
+         continue;
+
+      for (uint8_t r2 = r1 + 1; r2 < matrix->rows; r2++) {
+         const ebtn_mask_t shared = a & (state >> (r2 * matrix->cols));
+         if (shared & (shared - 1))
+            blocked |= (col_mask << (r1 * matrix->cols)) | (col_mask << (r2 * matrix->cols));
+      }
+   }
+
+   if (!blocked)
+      return state;
+
+   matrix->internal.ghosts++;
+
+   const ebtn_mask_t prev = __atomic_load_n(&matrix->internal.state, __ATOMIC_RELAXED);
+   return (state & ~blocked) | (prev & blocked);
+}
+
+// one column read per row, independent of the number of keys
+static void scan(button_matrix_t* matrix) {
+   const uint32_t col_mask = COL_MASK(matrix);
+   ebtn_mask_t state = 0;
+
+   for (uint8_t row = 0; row < matrix->rows; row++) {
+      matrix->select_callback(matrix, row, true);
+      if (matrix->settle_us)
+         ebtn_hal_delay_us(matrix->settle_us);
+
+      const uint32_t cols = matrix->read_callback(matrix) & col_mask;
+      matrix->select_callback(matrix, row, false);
+
+      state |= (ebtn_mask_t)cols << (row * matrix->cols);
+   }
+
+   if (!matrix->diodes)
+      state = block_ghosts(matrix, state);
+
+   if (state != __atomic_load_n(&matrix->internal.state, __ATOMIC_RELAXED)) {
+      __atomic_store_n(&matrix->internal.state, state, __ATOMIC_RELEASE);
+
+      button_port_wake(&matrix->port); // button polling may be idle
+   }
+}
+
+static void scan_timer(void* arg) {
+   scan(arg);
+}
+
+static ebtn_mask_t read_port(uint8_t port, void* ctx) {
+   button_matrix_t* matrix = ctx;
+
+   if (!matrix->internal.timer)
+      scan(matrix);
+
+   return __atomic_load_n(&matrix->internal.state, __ATOMIC_ACQUIRE);
+}
+
+esp_err_t button_matrix_init(button_matrix_t* matrix) {
+   ESP_RETURN_ON_FALSE(matrix, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+   ESP_RETURN_ON_FALSE(matrix->rows && matrix->cols && matrix->cols <= 32 && matrix->rows * matrix->cols <= EBTN_MASK_BITS, ESP_ERR_INVALID_ARG, TAG,
+                       "Invalid matrix size");
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   // the button poll stops while idle, and a matrix scanned from it would never see the next press
+   ESP_RETURN_ON_FALSE(matrix->scan_interval_us, ESP_ERR_INVALID_ARG, TAG, "Scan interval required with idle shutdown");
+#endif
+   ESP_RETURN_ON_FALSE(matrix->select_callback || matrix->row_pins, ESP_ERR_INVALID_ARG, TAG, "Missing row pins");
+   ESP_RETURN_ON_FALSE(matrix->read_callback || matrix->col_pins, ESP_ERR_INVALID_ARG, TAG, "Missing column pins");
+   ESP_RETURN_ON_FALSE(matrix->select_callback || matrix->active_low || matrix->diodes, ESP_ERR_INVALID_ARG, TAG,
+                       "Active high rows without diodes would short deselected rows");
+
+   if (!matrix->select_callback) {
+      for (uint8_t row = 0; row < matrix->rows; row++)
+         ESP_RETURN_ON_ERROR(ebtn_hal_gpio_output_init(matrix->row_pins[row], matrix->active_low, matrix->active_low), TAG, "Failed to init row GPIO");
+      matrix->select_callback = select_row;
+   }
+
+   if (!matrix->read_callback) {
+      for (uint8_t col = 0; col < matrix->cols; col++)
+         ESP_RETURN_ON_ERROR(ebtn_hal_gpio_input_init(matrix->col_pins[col], matrix->internal_pull, matrix->active_low), TAG, "Failed to init column GPIO");
+      matrix->read_callback = read_cols;
+   }
+
+   matrix->internal.state = 0;
+   matrix->internal.ghosts = 0;
+   matrix->internal.timer = NULL;
+
+   matrix->port.poll_port_callback = read_port;
+   matrix->port.ctx = matrix;
+
+   if (!matrix->scan_interval_us)
+      return ESP_OK;
+
+   esp_err_t ret = ESP_OK;
+   ebtn_hal_timer_t timer;
+   ESP_RETURN_ON_ERROR(ebtn_hal_timer_create("scan_matrix", scan_timer, matrix, &timer), TAG, "Failed to create matrix timer");
+   ESP_GOTO_ON_ERROR(ebtn_hal_timer_start_periodic(timer, matrix->scan_interval_us), fail, TAG, "Failed to start matrix timer");
+
+   matrix->internal.timer = timer;
+   return ESP_OK;
+
+fail:
+   ebtn_hal_timer_delete(timer);
+   return ret;
+}
+
+esp_err_t button_matrix_free(button_matrix_t* matrix) {
+   ESP_RETURN_ON_FALSE(matrix, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+   ESP_RETURN_ON_FALSE(!matrix->port.internal.used, ESP_ERR_INVALID_STATE, TAG, "Matrix still has buttons");
+
+   if (matrix->internal.timer) {
+      ebtn_hal_timer_delete(matrix->internal.timer);
+      matrix->internal.timer = NULL;
+   }
+
+   return ESP_OK;
+}
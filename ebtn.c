@@ -0,0 +1,89 @@
+#include "ebtn.h"
+
+#include <stdatomic.h>
+
+#include "ebtn_hal.h"
+#include "ebtn_prepoll.h"
+#include "ebtn_sched.h"
+
+#if CONFIG_EBTN_UNIFIED_TIMER
+static ebtn_hal_timer_t timer;
+static uint8_t attached = 0;    // engines attached, only changed by init/free, accessed atomically
+static atomic_uint running = 0; // engines started
+static uint32_t tick = 0;       // ticks since the buttons were started, reset by start from task context, accessed atomically
+
+static ebtn_prepoll_cb_t _prepoll_callback = NULL;
+static ebtn_prepoll_async_t* _prepoll_async = NULL;
+
+static void poll(void* arg) {
+   // read once for both engines, e.g. a shared port expander
+   if (_prepoll_callback)
+      _prepoll_callback();
+   if (_prepoll_async)
+      ebtn_prepoll_async_tick(_prepoll_async);
+
+   const unsigned clients = atomic_load(&running);
+
+   if (clients & EBTN_SCHED_ENCODERS)
+      ebtn_sched_poll_encoders();
+
+   if (clients & EBTN_SCHED_BUTTONS) {
+      const uint32_t t = __atomic_load_n(&tick, __ATOMIC_RELAXED);
+      if (t == 0)
+         ebtn_sched_poll_buttons();
+
+      // a reset by ebtn_sched_start() in between is overwritten, delaying the first button poll by at most one period
+      __atomic_store_n(&tick, t + 1 == EBTN_SCHED_BTN_TICKS ? 0 : t + 1, __ATOMIC_RELAXED);
+   }
+}
+
+esp_err_t ebtn_sched_attach(ebtn_sched_client_t client) {
+   if (!__atomic_load_n(&attached, __ATOMIC_ACQUIRE)) {
+#if CONFIG_EBTN_POLL_TASK
+      static const ebtn_task_config_t task = EBTN_TASK_CONFIG_DEFAULT;
+      const esp_err_t err = ebtn_hal_timer_create_task("poll_ebtn", poll, NULL, &task, &timer);
+#else
+      const esp_err_t err = ebtn_hal_timer_create("poll_ebtn", poll, NULL, &timer);
+#endif
+      if (err != ESP_OK)
+         return err;
+   }
+
+   __atomic_fetch_or(&attached, client, __ATOMIC_RELEASE);
+   return ESP_OK;
+}
+
+esp_err_t ebtn_sched_detach(ebtn_sched_client_t client) {
+   if (__atomic_and_fetch(&attached, ~client, __ATOMIC_ACQ_REL))
+      return ESP_OK;
+
+   const esp_err_t err = ebtn_hal_timer_delete(timer);
+   timer = NULL;
+   return err;
+}
+
+esp_err_t ebtn_sched_start(ebtn_sched_client_t client) {
+   if (client & EBTN_SCHED_BUTTONS)
+      __atomic_store_n(&tick, 0, __ATOMIC_RELAXED);
+
+   if (atomic_fetch_or(&running, client) & ~client)
+      return ESP_OK; // already ticking for the other engine
+
+   return ebtn_hal_timer_start_periodic(timer, CONFIG_EBTN_POLLING_INTERVAL_US_ENC);
+}
+
+esp_err_t ebtn_sched_stop(ebtn_sched_client_t client) {
+   if (atomic_fetch_and(&running, ~client) & ~client)
+      return ESP_OK; // still ticking for the other engine
+
+   return ebtn_hal_timer_stop(timer);
+}
+
+void ebtn_set_prepoll_callback(ebtn_prepoll_cb_t prepoll_callback) {
+   _prepoll_callback = prepoll_callback;
+}
+
+void ebtn_set_prepoll_async(ebtn_prepoll_async_t* prepoll) {
+   _prepoll_async = prepoll;
+}
+#endif
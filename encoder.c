@@ -1,15 +1,28 @@
 #include "encoder.h"
 
 #include <esp_check.h>
-#include <esp_timer.h>
+#include <esp_attr.h>
 #include <freertos/semphr.h>
-#include <driver/gpio.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "ebtn_hal.h"
+#include "ebtn_ring.h"
+#include "ebtn_rate.h"
+#include "ebtn_prepoll.h"
+#include "ebtn_registry.h"
+#include "ebtn_sched.h"
+#include "ebtn_snapshot.h"
+#include "ebtn_stats.h"
 
 static const char* TAG = "ebtn-encoder";
 
+// lock wait, a poll of the engine can hold up add/remove for about one of its intervals
+#define MUTEX_TIMEOUT(engine) (pdMS_TO_TICKS(((engine)->interval_us + 999U) / 1000U) + 1)
+
 #define SEMAPHORE_TAKE()                                                                                                                                       \
    do {                                                                                                                                                        \
-      if (!xSemaphoreTake(mutex, pdMS_TO_TICKS(CONFIG_EBTN_POLLING_INTERVAL_US_ENC / 1000U))) {                                                                \
+      if (!xSemaphoreTake(engine->mutex, MUTEX_TIMEOUT(engine))) {                                                                                             \
          ESP_LOGE(TAG, "Could not take mutex");                                                                                                                \
          return ESP_ERR_TIMEOUT;                                                                                                                               \
       }                                                                                                                                                        \
@@ -17,180 +30,1124 @@ static const char* TAG = "ebtn-encoder";
 
 #define SEMAPHORE_GIVE()                                                                                                                                       \
    do {                                                                                                                                                        \
-      if (!xSemaphoreGive(mutex)) {                                                                                                                            \
+      if (!xSemaphoreGive(engine->mutex)) {                                                                                                                    \
          ESP_LOGE(TAG, "Could not give mutex");                                                                                                                \
          return ESP_FAIL;                                                                                                                                      \
       }                                                                                                                                                        \
    } while (0)
 
-static esp_timer_handle_t timer;
-static QueueHandle_t _queue;
-static SemaphoreHandle_t mutex;
+struct rotary_encoder_engine {
+   int64_t now_us; // time of the current poll
 
-static ebtn_prepoll_cb_t _prepoll_callback = NULL;
+   // read by poll() without locking, the mutex only serializes add/remove
+   ebtn_epoch_t epoch;
+   ebtn_registry_t encoders;
+   ebtn_registry_t ports;
 
-static rotary_encoder_t* encoders[CONFIG_EBTN_MAX_COUNT_ENC] = {NULL};
+   ebtn_hal_timer_t timer; // NULL if polled from the shared timer
+   uint32_t interval_us;
+   QueueHandle_t queue;
+   SemaphoreHandle_t mutex;
 
-static const uint8_t valid_states[] = {0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0};
+   rotary_encoder_event_cb_t event_callback;
+   ebtn_prepoll_cb_t prepoll_callback;
+   ebtn_prepoll_async_t* prepoll_async;
 
-inline static void encoder_poll(rotary_encoder_t* enc) {
-   if (!enc->poll_state_callback)
+#if CONFIG_EBTN_EVENT_RING
+   rotary_encoder_event_t ring_buf[1 << CONFIG_EBTN_EVENT_RING_ORDER_ENC];
+   rotary_encoder_event_t ring_overflow;
+   ebtn_ring_t ring;
+   TaskHandle_t consumer;
+   bool ring_pushed; // events were pushed during the current poll
+#endif
+
+#if CONFIG_EBTN_STATS
+   int64_t next_poll_us; // scheduled time of the next poll, 0 if unknown
+#endif
+
+#if CONFIG_EBTN_ENC_ISR
+   atomic_bool idle; // true while the polling timer is stopped waiting for a step
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   ebtn_rate_t rate;
+   portMUX_TYPE rate_lock;
+#endif
+
+   _Atomic(void*) slots[]; // registry arrays of created engines, unless dynamic
+};
+
+// engine of the global API
+static rotary_encoder_engine_t default_engine;
+EBTN_REGISTRY_STORAGE(encoder_slots, CONFIG_EBTN_MAX_COUNT_ENC);
+EBTN_REGISTRY_STORAGE(port_slots, CONFIG_EBTN_MAX_COUNT_ENC_PORTS);
+
+#if CONFIG_EBTN_ENC_ISR
+// decoded from edge interrupts instead of being sampled by poll()
+#define ISR_DRIVEN(enc) ((enc)->poll_state_callback == ebtn_hal_gpio_get_level)
+#endif
+
+// Decoder transitions per step mode, indexed by [state][new A/B sample]. States are the armed direction (none, cw, ccw) * 4
+// plus the last A/B sample, an entry is the next state | STEP_CW/STEP_CCW if a step completed | STEP_MOVED for any valid transition.
+// Invalid transitions (both or no channels changed) only track the sample and keep the armed direction.
+// Kept in RAM, as the tables are also read by the edge interrupt handler.
+#define STEP_CW 0x10
+#define STEP_CCW 0x20
+#define STEP_MOVED 0x40
+
+static const DRAM_ATTR uint8_t transitions[3][12][4] = {
+   [ROT_STEP_FULL] = {
+      {0x00, 0x45, 0x4a, 0x03}, // none 00
+      {0x40, 0x01, 0x02, 0x43}, // none 01
+      {0x40, 0x01, 0x02, 0x43}, // none 10
+      {0x00, 0x41, 0x42, 0x03}, // none 11
+      {0x04, 0x45, 0x4a, 0x07}, // cw   00
+      {0x40, 0x05, 0x06, 0x53}, // cw   01
+      {0x40, 0x05, 0x06, 0x43}, // cw   10
+      {0x04, 0x41, 0x42, 0x07}, // cw   11
+      {0x08, 0x45, 0x4a, 0x0b}, // ccw  00
+      {0x40, 0x09, 0x0a, 0x43}, // ccw  01
+      {0x40, 0x09, 0x0a, 0x63}, // ccw  10
+      {0x08, 0x41, 0x42, 0x0b}, // ccw  11
+   },
+   [ROT_STEP_HALF] = {
+      {0x00, 0x45, 0x4a, 0x03}, // none 00
+      {0x40, 0x01, 0x02, 0x43}, // none 01
+      {0x40, 0x01, 0x02, 0x43}, // none 10
+      {0x00, 0x49, 0x46, 0x03}, // none 11
+      {0x04, 0x45, 0x4a, 0x07}, // cw   00
+      {0x40, 0x05, 0x06, 0x53}, // cw   01
+      {0x50, 0x05, 0x06, 0x43}, // cw   10
+      {0x04, 0x49, 0x46, 0x07}, // cw   11
+      {0x08, 0x45, 0x4a, 0x0b}, // ccw  00
+      {0x60, 0x09, 0x0a, 0x43}, // ccw  01
+      {0x40, 0x09, 0x0a, 0x63}, // ccw  10
+      {0x08, 0x49, 0x46, 0x0b}, // ccw  11
+   },
+   [ROT_STEP_QUARTER] = {
+      {0x00, 0x51, 0x62, 0x03}, // none 00
+      {0x60, 0x01, 0x02, 0x53}, // none 01
+      {0x50, 0x01, 0x02, 0x63}, // none 10
+      {0x00, 0x61, 0x52, 0x03}, // none 11
+      {0x04, 0x51, 0x62, 0x07}, // cw   00
+      {0x60, 0x05, 0x06, 0x53}, // cw   01
+      {0x50, 0x05, 0x06, 0x63}, // cw   10
+      {0x04, 0x61, 0x52, 0x07}, // cw   11
+      {0x08, 0x51, 0x62, 0x0b}, // ccw  00
+      {0x60, 0x09, 0x0a, 0x53}, // ccw  01
+      {0x50, 0x09, 0x0a, 0x63}, // ccw  10
+      {0x08, 0x61, 0x52, 0x0b}, // ccw  11
+   },
+};
+
+#if CONFIG_EBTN_PORT_MASK_64
+#define MASK_BIT(n) (1ULL << (n))
+#define MASK_CTZ(m) __builtin_ctzll(m)
+#else
+#define MASK_BIT(n) (1UL << (n))
+#define MASK_CTZ(m) __builtin_ctzl(m)
+#endif
+
+#if CONFIG_EBTN_COMPACT
+// events carry the id of the encoder instead of a pointer to it, and the timestamp in ticks
+#define EVENT_SENDER(enc) .id = (enc)->id
+#define EVENT_TIMESTAMP(engine) .timestamp_ticks = ebtn_hal_ticks((engine)->now_us)
+#define SAME_SENDER(a, b) ((a)->id == (b)->id)
+#else
+#define EVENT_SENDER(enc) .sender = (enc)
+#define EVENT_TIMESTAMP(engine) .timestamp_us = (engine)->now_us
+#define SAME_SENDER(a, b) ((a)->sender == (b)->sender)
+#endif
+
+// returns false if the event was dropped
+inline static bool push_event(rotary_encoder_engine_t* engine, rotary_encoder_t* enc, const rotary_encoder_event_t* evt) {
+   const rotary_encoder_event_cb_t callback = enc->event_callback ? enc->event_callback : engine->event_callback;
+   if (callback) {
+      callback(evt);
+      return true;
+   }
+
+#if CONFIG_EBTN_EVENT_RING
+   if (!engine->queue) {
+      const bool pushed = ebtn_ring_push(&engine->ring, evt);
+      engine->ring_pushed |= pushed;
+      return pushed;
+   }
+#endif
+   return xQueueSendToBack(engine->queue, evt, 0) == pdTRUE;
+}
+
+inline static void send_event(rotary_encoder_engine_t* engine, rotary_encoder_t* enc, const rotary_encoder_event_t* evt) {
+   const bool sent = push_event(engine, enc, evt);
+
+#if CONFIG_EBTN_STATS
+   ebtn_stats_event(&ebtn_stats.encoders, evt->dir == ROT_CLOCKWISE ? 0 : 1, sent);
+   if (sent) {
+      enc->internal.events_sent++;
+   } else {
+      enc->internal.events_dropped++;
+   }
+#else
+   (void)sent;
+#endif
+}
+
+#if CONFIG_EBTN_STATS
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+#define PERIOD_US(engine) ((engine)->rate.period_us)
+#else
+#define PERIOD_US(engine) ((engine)->interval_us)
+#endif
+#endif
+
+#if CONFIG_EBTN_ENC_COALESCE
+
+#if CONFIG_EBTN_ENC_ACCEL
+_Static_assert(CONFIG_EBTN_ENC_ACCEL_MAX_SPEED > CONFIG_EBTN_ENC_ACCEL_MIN_SPEED, "CONFIG_EBTN_ENC_ACCEL_MAX_SPEED must be above CONFIG_EBTN_ENC_ACCEL_MIN_SPEED");
+
+inline static int16_t accelerate(int16_t delta, uint16_t velocity) {
+   if (velocity <= CONFIG_EBTN_ENC_ACCEL_MIN_SPEED)
+      return delta;
+
+   // linear ramp from 1x at MIN_SPEED to MAX_FACTOR at MAX_SPEED, in 1/256 steps
+   uint32_t factor = CONFIG_EBTN_ENC_ACCEL_MAX_FACTOR * 256;
+   if (velocity < CONFIG_EBTN_ENC_ACCEL_MAX_SPEED)
+      factor = 256 + ((velocity - CONFIG_EBTN_ENC_ACCEL_MIN_SPEED) * (CONFIG_EBTN_ENC_ACCEL_MAX_FACTOR - 1) * 256) /
+                         (CONFIG_EBTN_ENC_ACCEL_MAX_SPEED - CONFIG_EBTN_ENC_ACCEL_MIN_SPEED);
+
+   const int32_t accel = ((int32_t)delta * (int32_t)factor) / 256;
+   return accel > INT16_MAX ? INT16_MAX : (accel < -INT16_MAX ? -INT16_MAX : accel);
+}
+#endif
+
+// sends the accumulated steps once the coalescing interval has passed, returns true while steps are still held back
+inline static bool publish(rotary_encoder_engine_t* engine, rotary_encoder_t* enc) {
+   if (!enc->internal.steps)
+      return false;
+
+   const uint64_t elapsed = engine->now_us - enc->internal.last_event_us;
+#if CONFIG_EBTN_ENC_COALESCE_INTERVAL_US > 0
+   if (elapsed < CONFIG_EBTN_ENC_COALESCE_INTERVAL_US)
+      return true;
+#endif
+
+   const int16_t delta = enc->internal.steps;
+   const uint64_t velocity = ((uint64_t)(delta < 0 ? -delta : delta) * 1000000U) / (elapsed ? elapsed : 1);
+
+   rotary_encoder_event_t evt = {
+       EVENT_SENDER(enc),
+       EVENT_TIMESTAMP(engine),
+       .dir = delta > 0 ? ROT_CLOCKWISE : ROT_COUNTERCLOCKWISE,
+       .delta = delta,
+       .velocity = velocity > UINT16_MAX ? UINT16_MAX : velocity,
+   };
+#if CONFIG_EBTN_ENC_ACCEL
+   evt.accel_delta = accelerate(delta, evt.velocity);
+#endif
+   send_event(engine, enc, &evt);
+
+   enc->internal.steps = 0;
+   enc->internal.last_event_us = engine->now_us;
+   return false;
+}
+
+#if CONFIG_EBTN_EVENT_RING
+// coalescing overflow policy of the event ring
+static bool merge_event(void* dst, const void* src) {
+   rotary_encoder_event_t* a = dst;
+   const rotary_encoder_event_t* b = src;
+
+   if (!SAME_SENDER(a, b) || a->dir != b->dir)
+      return false;
+
+   const int16_t delta = a->delta + b->delta;
+#if CONFIG_EBTN_ENC_ACCEL
+   const int16_t accel_delta = a->accel_delta + b->accel_delta;
+#endif
+
+   *a = *b; // keep the latest timestamp and velocity
+   a->delta = delta;
+#if CONFIG_EBTN_ENC_ACCEL
+   a->accel_delta = accel_delta;
+#endif
+   return true;
+}
+#endif
+#endif
+
+#if CONFIG_EBTN_SNAPSHOT
+inline static int32_t limit_position(const rotary_encoder_t* enc, int64_t position) {
+   const int64_t min = enc->position_min;
+   const int64_t max = enc->position_max;
+
+   if (min == max)
+      return (int32_t)position; // unlimited, wraps at the int32_t range
+
+   if (enc->position_wrap) {
+      const int64_t range = max - min + 1;
+      return min + (((position - min) % range) + range) % range;
+   }
+   return position < min ? min : (position > max ? max : position);
+}
+
+inline static void move(rotary_encoder_t* enc, int16_t steps) {
+   enc->internal.position = limit_position(enc, (int64_t)enc->internal.position + steps);
+   ebtn_snapshot_set_position(enc->id, enc->internal.position);
+}
+#endif
+
+inline static void step(rotary_encoder_engine_t* engine, rotary_encoder_t* enc, rotary_encoder_rotation_t dir) {
+#if CONFIG_EBTN_SNAPSHOT
+   move(enc, dir);
+#endif
+
+#if CONFIG_EBTN_ENC_COALESCE
+   enc->internal.steps += dir;
+#else
+   rotary_encoder_event_t evt = {EVENT_SENDER(enc), EVENT_TIMESTAMP(engine), .dir = dir};
+   send_event(engine, enc, &evt);
+#endif
+}
+
+// samples the encoder and advances its state machine, returns the transition table entry
+inline static uint8_t decode(rotary_encoder_t* enc) {
+   const uint8_t sample = ((enc->poll_state_callback(enc->pin_a) ^ enc->active_low) << 1) | (enc->poll_state_callback(enc->pin_b) ^ enc->active_low);
+   const uint8_t next = transitions[enc->step_mode][enc->internal.state][sample];
+
+   enc->internal.state = next & 0xf;
+   return next;
+}
+
+#if CONFIG_EBTN_ENC_ISR
+static void IRAM_ATTR encoder_wake(rotary_encoder_engine_t* engine) {
+   if (atomic_exchange(&engine->idle, false))
+      ebtn_hal_timer_start_periodic(engine->timer, engine->interval_us);
+}
+
+// advances the state machine from the current pin levels, steps are handed to poll() through isr_steps
+static void IRAM_ATTR isr_decode(rotary_encoder_t* enc) {
+   const uint8_t next = decode(enc);
+   if (next & (STEP_CW | STEP_CCW)) {
+      __atomic_fetch_add(&enc->internal.isr_steps, (next & STEP_CW) ? 1 : -1, __ATOMIC_RELEASE);
+      encoder_wake(enc->internal.engine);
+   }
+}
+
+#if CONFIG_EBTN_ENC_ISR_GLITCH_US > 0
+// edge_isr() and a resample by poll() both advance the state machine
+static portMUX_TYPE decode_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+// Any edge on A or B. Only ever runs on the core that installed the GPIO ISR service, so without the glitch filter the state
+// machine needs no locking.
+static void IRAM_ATTR edge_isr(void* arg) {
+   rotary_encoder_t* enc = arg;
+
+#if CONFIG_EBTN_ENC_ISR_GLITCH_US > 0
+   const uint32_t now = (uint32_t)ebtn_hal_time_us();
+   if (now - enc->internal.last_edge_us < CONFIG_EBTN_ENC_ISR_GLITCH_US) {
+      // a real edge right after a bounce has no further edge to be decoded from, so the next poll samples the pins again
+      __atomic_store_n(&enc->internal.resample, true, __ATOMIC_RELEASE);
+      encoder_wake(enc->internal.engine);
       return;
+   }
+   enc->internal.last_edge_us = now;
+
+   portENTER_CRITICAL_ISR(&decode_lock);
+   isr_decode(enc);
+   portEXIT_CRITICAL_ISR(&decode_lock);
+#else
+   isr_decode(enc);
+#endif
+}
+
+// sends the steps decoded by edge_isr() since the last poll, returns true if there were any
+inline static bool collect(rotary_encoder_engine_t* engine, rotary_encoder_t* enc) {
+#if CONFIG_EBTN_ENC_ISR_GLITCH_US > 0
+   if (__atomic_exchange_n(&enc->internal.resample, false, __ATOMIC_ACQUIRE)) {
+      portENTER_CRITICAL(&decode_lock);
+      isr_decode(enc);
+      portEXIT_CRITICAL(&decode_lock);
+   }
+#endif
 
-   const uint8_t state = ((enc->poll_state_callback(enc->pin_a) ^ enc->active_low) << 1) | (enc->poll_state_callback(enc->pin_b) ^ enc->active_low);
+   const int16_t steps = __atomic_exchange_n(&enc->internal.isr_steps, 0, __ATOMIC_ACQUIRE);
 
-   enc->internal.code = ((enc->internal.code << 2) | state) & 0xf;
+#if CONFIG_EBTN_ENC_COALESCE
+#if CONFIG_EBTN_SNAPSHOT
+   if (steps)
+      move(enc, steps);
+#endif
+   enc->internal.steps += steps;
+#else
+   for (int16_t i = steps; i > 0; i--)
+      step(engine, enc, ROT_CLOCKWISE);
+   for (int16_t i = steps; i < 0; i++)
+      step(engine, enc, ROT_COUNTERCLOCKWISE);
+#endif
 
-   if (valid_states[enc->internal.code]) {
-      enc->internal.store = (enc->internal.store << 4) | enc->internal.code;
+   return steps != 0;
+}
+#endif
 
-      rotary_encoder_event_t evt = {.sender = enc};
+// returns true if the encoder moved
+inline static bool encoder_poll(rotary_encoder_engine_t* engine, rotary_encoder_t* enc) {
+   if (!enc->poll_state_callback)
+      return false;
 
-      if ((enc->internal.store & 0xff) == 0x2b) {
-         evt.dir = ROT_COUNTERCLOCKWISE;
-         xQueueSendToBack(_queue, &evt, 0);
+   bool moved;
+#if CONFIG_EBTN_ENC_ISR
+   if (ISR_DRIVEN(enc)) {
+      moved = collect(engine, enc);
+   } else
+#endif
+   {
+      const uint8_t next = decode(enc);
 
-      } else if ((enc->internal.store & 0xff) == 0x17) {
-         evt.dir = ROT_CLOCKWISE;
-         xQueueSendToBack(_queue, &evt, 0);
+      if (next & STEP_CW) {
+         step(engine, enc, ROT_CLOCKWISE);
+      } else if (next & STEP_CCW) {
+         step(engine, enc, ROT_COUNTERCLOCKWISE);
       }
+
+      moved = next & STEP_MOVED;
    }
+
+#if CONFIG_EBTN_ENC_COALESCE
+   publish(engine, enc);
+#endif
+
+   return moved;
 }
 
-static void poll(void* arg) {
-   if (_prepoll_callback)
-      _prepoll_callback();
+inline static void port_step(rotary_encoder_engine_t* engine, rotary_encoder_port_t* port, ebtn_mask_t mask, rotary_encoder_rotation_t dir) {
+   while (mask) {
+      const uint8_t bit = MASK_CTZ(mask);
+      mask &= mask - 1;
 
-   if (!xSemaphoreTake(mutex, 0))
-      return;
+      rotary_encoder_t* enc = __atomic_load_n(&port->internal.encoders[bit], __ATOMIC_ACQUIRE);
+      if (enc)
+         step(engine, enc, dir);
+   }
+}
 
-   for (uint8_t i = 0; i < CONFIG_EBTN_MAX_COUNT_ENC; i++) {
-      if (encoders[i])
-         encoder_poll(encoders[i]);
+// Bit-sliced equivalent of encoder_poll(), advancing the state machines of every encoder in the port at once.
+// The armed direction of the transition tables is kept as the arm_cw/arm_ccw masks, and the previous sample as a/b.
+// returns true if any encoder of the port moved
+inline static bool port_poll(rotary_encoder_engine_t* engine, rotary_encoder_port_t* port) {
+   const ebtn_mask_t used = __atomic_load_n(&port->internal.used, __ATOMIC_ACQUIRE);
+
+   // bits added since the last poll start at rest, the rest of the port state is only ever touched here
+   const ebtn_mask_t reset = __atomic_exchange_n(&port->internal.reset, 0, __ATOMIC_ACQUIRE);
+   if (reset) {
+      port->internal.a &= ~reset;
+      port->internal.b &= ~reset;
+      port->internal.arm_cw &= ~reset;
+      port->internal.arm_ccw &= ~reset;
+#if CONFIG_EBTN_ENC_COALESCE
+      port->internal.pending &= ~reset;
+#endif
    }
 
-   xSemaphoreGive(mutex);
+   const ebtn_mask_t invert = __atomic_load_n(&port->internal.invert, __ATOMIC_RELAXED);
+   const ebtn_mask_t half = __atomic_load_n(&port->internal.half, __ATOMIC_RELAXED);
+   const ebtn_mask_t quarter = __atomic_load_n(&port->internal.quarter, __ATOMIC_RELAXED);
+   ebtn_mask_t a, b;
+   port->poll_port_callback(port->port, port->ctx, &a, &b);
+   a ^= invert;
+   b ^= invert;
+
+   const ebtn_mask_t pa = port->internal.a;
+   const ebtn_mask_t pb = port->internal.b;
+
+   const ebtn_mask_t valid = ((a ^ pa) ^ (b ^ pb)) & used; // exactly one channel changed
+   const ebtn_mask_t from_rest = valid & ~pa & ~pb;        // 00 -> 01 or 00 -> 10
+   const ebtn_mask_t from_top = valid & pa & pb & half;    // 11 -> 10 or 11 -> 01, half step only
+   const ebtn_mask_t to_top = valid & a & b;               // 01 -> 11 or 10 -> 11
+   const ebtn_mask_t to_rest = valid & ~a & ~b & half;     // 10 -> 00 or 01 -> 00, half step only
+
+   const ebtn_mask_t arm_cw = port->internal.arm_cw;
+   const ebtn_mask_t arm_ccw = port->internal.arm_ccw;
+
+   ebtn_mask_t cw = (arm_cw & ~pa & pb & to_top) | (arm_cw & pa & ~pb & to_rest);   // 00 -> 01 -> 11, 11 -> 10 -> 00
+   ebtn_mask_t ccw = (arm_ccw & pa & ~pb & to_top) | (arm_ccw & ~pa & pb & to_rest); // 00 -> 10 -> 11, 11 -> 01 -> 00
+
+   if (quarter) {
+      // clockwise is B changing to differ from A, or A changing to match B
+      const ebtn_mask_t turn_cw = valid & quarter & (((b ^ pb) & (a ^ b)) | ((a ^ pa) & ~(a ^ b)));
+      cw = (cw & ~quarter) | turn_cw;
+      ccw = (ccw & ~quarter) | (valid & quarter & ~turn_cw);
+   }
+
+   port->internal.arm_cw = (arm_cw & ~valid) | (from_rest & b) | (from_top & ~b);
+   port->internal.arm_ccw = (arm_ccw & ~valid) | (from_rest & a) | (from_top & ~a);
+   port->internal.a = a;
+   port->internal.b = b;
+
+   if (cw)
+      port_step(engine, port, cw, ROT_CLOCKWISE);
+   if (ccw)
+      port_step(engine, port, ccw, ROT_COUNTERCLOCKWISE);
+
+#if CONFIG_EBTN_ENC_COALESCE
+   // only encoders with steps held back need checking
+   ebtn_mask_t pending = (port->internal.pending | cw | ccw) & used;
+   port->internal.pending = 0;
+
+   while (pending) {
+      const uint8_t bit = MASK_CTZ(pending);
+      pending &= pending - 1;
+
+      rotary_encoder_t* enc = __atomic_load_n(&port->internal.encoders[bit], __ATOMIC_ACQUIRE);
+      if (enc && publish(engine, enc))
+         port->internal.pending |= MASK_BIT(bit);
+   }
+#endif
+
+   return valid != 0;
 }
 
-static const esp_timer_create_args_t timer_args = {
-    .arg = NULL,
-    .name = "poll_encoders",
-    .dispatch_method = ESP_TIMER_TASK,
-    .callback = poll,
-};
+#if CONFIG_EBTN_UNIFIED_TIMER
+#define SHARED_TIMER(engine) ((engine) == &default_engine) // the global API polls from the shared timer
+#else
+#define SHARED_TIMER(engine) false
+#endif
 
-static uint8_t gpio_encoder_poll_state(gpio_num_t pin) {
-   return gpio_get_level(pin);
+static esp_err_t timer_start(rotary_encoder_engine_t* engine) {
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (SHARED_TIMER(engine))
+      return ebtn_sched_start(EBTN_SCHED_ENCODERS);
+#endif
+   return ebtn_hal_timer_start_periodic(engine->timer, engine->interval_us);
 }
 
-esp_err_t rotary_encoder_init(QueueHandle_t queue) {
-   ESP_RETURN_ON_FALSE(queue, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+static esp_err_t timer_stop(rotary_encoder_engine_t* engine) {
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (SHARED_TIMER(engine))
+      return ebtn_sched_stop(EBTN_SCHED_ENCODERS);
+#endif
+   return ebtn_hal_timer_stop(engine->timer);
+}
 
-   _queue = queue;
+#if CONFIG_EBTN_ENC_ISR
+static void idle_enter(rotary_encoder_engine_t* engine) {
+   // stop before flagging idle, so a step arriving in between can't be cancelled by the stop
+   ebtn_hal_timer_stop(engine->timer);
+   atomic_store(&engine->idle, true);
 
-   mutex = xSemaphoreCreateMutex();
-   ESP_RETURN_ON_FALSE(mutex, ESP_ERR_NO_MEM, TAG, "Failed to create mutex");
+#if CONFIG_EBTN_STATS
+   engine->next_poll_us = 0; // woken at any time
+#endif
 
-   ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &timer), TAG, "Failed to create encoder timer");
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   portENTER_CRITICAL(&engine->rate_lock);
+   ebtn_rate_stop(&engine->rate, ebtn_hal_time_us());
+   portEXIT_CRITICAL(&engine->rate_lock);
+#endif
 
-   return rotary_encoder_start();
+   // catch any step decoded (or edge filtered) after it was collected but before the timer stopped
+   const uint16_t count = ebtn_registry_count(&engine->encoders);
+   _Atomic(void*)* items = ebtn_registry_items(&engine->encoders);
+   for (uint16_t i = 0; i < count; i++) {
+      rotary_encoder_t* enc = ebtn_registry_get(items, i);
+#if CONFIG_EBTN_ENC_ISR_GLITCH_US > 0
+      if (__atomic_load_n(&enc->internal.isr_steps, __ATOMIC_RELAXED) || __atomic_load_n(&enc->internal.resample, __ATOMIC_RELAXED)) {
+#else
+      if (__atomic_load_n(&enc->internal.isr_steps, __ATOMIC_RELAXED)) {
+#endif
+         encoder_wake(engine);
+         return;
+      }
+   }
 }
+#endif
 
-esp_err_t rotary_encoder_free() {
+static void poll(void* arg) {
+   rotary_encoder_engine_t* engine = arg;
+
+#if CONFIG_EBTN_STATS
+   const int64_t dispatch_us = ebtn_hal_time_us();
+#endif
+
+   if (engine->prepoll_callback)
+      engine->prepoll_callback();
+   if (engine->prepoll_async)
+      ebtn_prepoll_async_tick(engine->prepoll_async);
+
+   ebtn_epoch_enter(&engine->epoch);
+
+   engine->now_us = ebtn_hal_time_us();
+
+   bool moved = false;
+   uint16_t count = ebtn_registry_count(&engine->encoders);
+   _Atomic(void*)* items = ebtn_registry_items(&engine->encoders);
+   void* seen = NULL;
+#if CONFIG_EBTN_ENC_ISR
+   bool busy = false; // something still needs the timer: a sampled encoder, a port or held back steps
+   for (uint16_t i = 0; i < count; i++) {
+      rotary_encoder_t* enc = ebtn_registry_next(&engine->encoders, items, i, &seen);
+      if (!enc)
+         continue;
+
+      moved |= encoder_poll(engine, enc);
+#if CONFIG_EBTN_ENC_COALESCE
+      busy |= !ISR_DRIVEN(enc) || enc->internal.steps;
+#else
+      busy |= !ISR_DRIVEN(enc);
+#endif
+   }
+#else
+   for (uint16_t i = 0; i < count; i++) {
+      rotary_encoder_t* enc = ebtn_registry_next(&engine->encoders, items, i, &seen);
+      if (enc)
+         moved |= encoder_poll(engine, enc);
+   }
+#endif
+
+   count = ebtn_registry_count(&engine->ports);
+   items = ebtn_registry_items(&engine->ports);
+   seen = NULL;
+   for (uint16_t i = 0; i < count; i++) {
+      rotary_encoder_port_t* port = ebtn_registry_next(&engine->ports, items, i, &seen);
+      if (port)
+         moved |= port_poll(engine, port);
+   }
+
+#if CONFIG_EBTN_EVENT_RING
+   if (!engine->queue) {
+      // a held back event published by the flush is news to the consumer as well
+      engine->ring_pushed |= ebtn_ring_flush(&engine->ring);
+
+      // one notification per poll instead of one per event
+      TaskHandle_t consumer = engine->consumer;
+      if (engine->ring_pushed && consumer)
+         xTaskNotifyGive(consumer);
+      engine->ring_pushed = false;
+   }
+#endif
+
+#if CONFIG_EBTN_STATS
+   ebtn_stats_poll(&ebtn_stats.encoders, &engine->next_poll_us, dispatch_us, PERIOD_US(engine));
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   portENTER_CRITICAL(&engine->rate_lock);
+   const uint32_t period_us = ebtn_rate_update(&engine->rate, engine->now_us, moved);
+   portEXIT_CRITICAL(&engine->rate_lock);
+
+   if (period_us) {
+      ebtn_hal_timer_restart(engine->timer, period_us);
+#if CONFIG_EBTN_STATS
+      engine->next_poll_us = 0; // restarting starts a new schedule
+#endif
+   }
+#endif
+
+#if CONFIG_EBTN_ENC_ISR
+   if (!busy && !ebtn_registry_count(&engine->ports))
+      idle_enter(engine);
+#endif
+
+   ebtn_epoch_exit(&engine->epoch);
+}
+
+static esp_err_t engine_init(rotary_encoder_engine_t* engine, const rotary_encoder_engine_config_t* config, _Atomic(void*)* encoder_storage,
+                             _Atomic(void*)* port_storage) {
+#if CONFIG_EBTN_EVENT_RING
+#if CONFIG_EBTN_ENC_COALESCE
+   ebtn_ring_init(&engine->ring, engine->ring_buf, &engine->ring_overflow, sizeof(rotary_encoder_event_t), 1 << CONFIG_EBTN_EVENT_RING_ORDER_ENC, merge_event);
+#else
+   // single step events can't be merged, so coalescing falls back to dropping the newest
+   ebtn_ring_init(&engine->ring, engine->ring_buf, &engine->ring_overflow, sizeof(rotary_encoder_event_t), 1 << CONFIG_EBTN_EVENT_RING_ORDER_ENC, NULL);
+#endif
+#else
+   ESP_RETURN_ON_FALSE(config->queue, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+#endif
+
+   engine->queue = config->queue;
+   engine->interval_us = config->interval_us ? config->interval_us : CONFIG_EBTN_POLLING_INTERVAL_US_ENC;
+
+   const uint16_t max_encoders = config->max_encoders ? config->max_encoders : CONFIG_EBTN_MAX_COUNT_ENC;
+   const uint16_t max_ports = config->max_ports ? config->max_ports : CONFIG_EBTN_MAX_COUNT_ENC_PORTS;
+
+   esp_err_t ret = ESP_OK;
+#if CONFIG_EBTN_UNIFIED_TIMER
+   bool scheduled = false;
+#endif
+   ESP_GOTO_ON_ERROR(ebtn_registry_init(&engine->encoders, encoder_storage, max_encoders, offsetof(rotary_encoder_t, internal.index), &engine->epoch), err,
+                     TAG, "Failed to create encoder registry");
+   ESP_GOTO_ON_ERROR(ebtn_registry_init(&engine->ports, port_storage, max_ports, offsetof(rotary_encoder_port_t, internal.index), &engine->epoch), err, TAG,
+                     "Failed to create port registry");
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   const uint32_t idle_us = CONFIG_EBTN_POLLING_IDLE_INTERVAL_US_ENC;
+   portMUX_INITIALIZE(&engine->rate_lock);
+   ebtn_rate_init(&engine->rate, engine->interval_us, idle_us > engine->interval_us ? idle_us : engine->interval_us, CONFIG_EBTN_ADAPTIVE_QUIET_MS * 1000);
+#endif
+
+   engine->mutex = xSemaphoreCreateMutex();
+   ESP_GOTO_ON_FALSE(engine->mutex, ESP_ERR_NO_MEM, err, TAG, "Failed to create mutex");
+
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (SHARED_TIMER(engine)) {
+      ESP_GOTO_ON_ERROR(ebtn_sched_attach(EBTN_SCHED_ENCODERS), err, TAG, "Failed to create shared timer");
+      scheduled = true;
+   } else
+#endif
+   {
+#if CONFIG_EBTN_POLL_TASK
+      static const ebtn_task_config_t default_task = EBTN_TASK_CONFIG_DEFAULT;
+      const ebtn_task_config_t* task = config->task ? config->task : &default_task;
+      ESP_GOTO_ON_ERROR(ebtn_hal_timer_create_task("poll_encoders", poll, engine, task, &engine->timer), err, TAG, "Failed to create encoder task");
+#else
+      ESP_GOTO_ON_ERROR(ebtn_hal_timer_create("poll_encoders", poll, engine, &engine->timer), err, TAG, "Failed to create encoder timer");
+#endif
+   }
+
+   ESP_GOTO_ON_ERROR(rotary_encoder_engine_start(engine), err, TAG, "Failed to start encoder polling");
+   return ESP_OK;
+
+err:
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (scheduled)
+      ebtn_sched_detach(EBTN_SCHED_ENCODERS);
+#endif
+   if (engine->timer)
+      ebtn_hal_timer_delete(engine->timer);
+   engine->timer = NULL;
+   if (engine->mutex)
+      vSemaphoreDelete(engine->mutex);
+   engine->mutex = NULL;
+   ebtn_registry_deinit(&engine->encoders);
+   ebtn_registry_deinit(&engine->ports);
+   return ret;
+}
+
+static esp_err_t engine_free(rotary_encoder_engine_t* engine) {
    SEMAPHORE_TAKE();
 
-   rotary_encoder_pause();
-   esp_timer_delete(timer);
-   timer = NULL;
+   rotary_encoder_engine_pause(engine);
+   ebtn_epoch_synchronize(&engine->epoch);
+#if CONFIG_EBTN_UNIFIED_TIMER
+   if (SHARED_TIMER(engine))
+      ebtn_sched_detach(EBTN_SCHED_ENCODERS);
+#endif
+   if (engine->timer)
+      ebtn_hal_timer_delete(engine->timer);
+   engine->timer = NULL;
+   ebtn_registry_deinit(&engine->encoders);
+   ebtn_registry_deinit(&engine->ports);
 
-   _queue = NULL;
+   engine->queue = NULL;
 
    SEMAPHORE_GIVE();
 
-   vSemaphoreDelete(mutex);
+   vSemaphoreDelete(engine->mutex);
+   engine->mutex = NULL;
    return ESP_OK;
 }
 
+esp_err_t rotary_encoder_init(QueueHandle_t queue) {
+   const rotary_encoder_engine_config_t config = {.queue = queue};
+   return engine_init(&default_engine, &config, encoder_slots, port_slots);
+}
+
+esp_err_t rotary_encoder_free() {
+   return engine_free(&default_engine);
+}
+
+esp_err_t rotary_encoder_engine_create(const rotary_encoder_engine_config_t* config, rotary_encoder_engine_t** out_engine) {
+   ESP_RETURN_ON_FALSE(config && out_engine, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+
+   // registry arrays follow the engine, unless the registries allocate them
+#if CONFIG_EBTN_REGISTRY_DYNAMIC
+   const size_t encoder_count = 0;
+   const size_t port_count = 0;
+#else
+   const size_t encoder_count = config->max_encoders ? config->max_encoders : CONFIG_EBTN_MAX_COUNT_ENC;
+   const size_t port_count = config->max_ports ? config->max_ports : CONFIG_EBTN_MAX_COUNT_ENC_PORTS;
+#endif
+
+   rotary_encoder_engine_t* engine = calloc(1, sizeof(rotary_encoder_engine_t) + (encoder_count + port_count) * sizeof(_Atomic(void*)));
+   ESP_RETURN_ON_FALSE(engine, ESP_ERR_NO_MEM, TAG, "Failed to allocate engine");
+
+   const esp_err_t err = engine_init(engine, config, encoder_count ? engine->slots : NULL, port_count ? engine->slots + encoder_count : NULL);
+   if (err != ESP_OK) {
+      free(engine);
+      return err;
+   }
+
+   *out_engine = engine;
+   return ESP_OK;
+}
+
+esp_err_t rotary_encoder_engine_delete(rotary_encoder_engine_t* engine) {
+   ESP_RETURN_ON_FALSE(engine && engine != &default_engine, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+
+   ESP_RETURN_ON_ERROR(engine_free(engine), TAG, "Failed to free engine");
+   free(engine);
+   return ESP_OK;
+}
+
+esp_err_t rotary_encoder_engine_pause(rotary_encoder_engine_t* engine) {
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   portENTER_CRITICAL(&engine->rate_lock);
+   ebtn_rate_stop(&engine->rate, ebtn_hal_time_us());
+   portEXIT_CRITICAL(&engine->rate_lock);
+#endif
+
+#if CONFIG_EBTN_ENC_ISR
+   if (atomic_exchange(&engine->idle, false)) // timer already stopped, and steps must no longer restart it
+      return ESP_OK;
+#endif
+   return timer_stop(engine);
+}
+
+esp_err_t rotary_encoder_engine_start(rotary_encoder_engine_t* engine) {
+#if CONFIG_EBTN_STATS
+   engine->next_poll_us = 0;
+#endif
+
+#if CONFIG_EBTN_ENC_ISR
+   atomic_store(&engine->idle, false);
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+   portENTER_CRITICAL(&engine->rate_lock);
+   ebtn_rate_start(&engine->rate, ebtn_hal_time_us());
+   portEXIT_CRITICAL(&engine->rate_lock);
+#endif
+
+   return timer_start(engine);
+}
+
 esp_err_t rotary_encoder_pause() {
-   return esp_timer_stop(timer);
+   return rotary_encoder_engine_pause(&default_engine);
 }
 
 esp_err_t rotary_encoder_start() {
-   return esp_timer_start_periodic(timer, CONFIG_EBTN_POLLING_INTERVAL_US_ENC);
+   return rotary_encoder_engine_start(&default_engine);
+}
+
+#if CONFIG_EBTN_EVENT_RING
+size_t rotary_encoder_engine_events_drain(rotary_encoder_engine_t* engine, rotary_encoder_event_t* buf, size_t n) {
+   return ebtn_ring_pop(&engine->ring, buf, n);
+}
+
+void rotary_encoder_engine_events_set_consumer(rotary_encoder_engine_t* engine, TaskHandle_t task) {
+   engine->consumer = task;
+}
+
+uint32_t rotary_encoder_engine_events_dropped(rotary_encoder_engine_t* engine) {
+   return atomic_load_explicit(&engine->ring.dropped, memory_order_relaxed);
+}
+
+size_t rotary_encoder_events_drain(rotary_encoder_event_t* buf, size_t n) {
+   return rotary_encoder_engine_events_drain(&default_engine, buf, n);
+}
+
+void rotary_encoder_events_set_consumer(TaskHandle_t task) {
+   rotary_encoder_engine_events_set_consumer(&default_engine, task);
+}
+
+uint32_t rotary_encoder_events_dropped() {
+   return rotary_encoder_engine_events_dropped(&default_engine);
+}
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+void rotary_encoder_engine_get_rate_info(rotary_encoder_engine_t* engine, ebtn_rate_info_t* info) {
+   portENTER_CRITICAL(&engine->rate_lock);
+   ebtn_rate_get(&engine->rate, ebtn_hal_time_us(), info);
+   portEXIT_CRITICAL(&engine->rate_lock);
+}
+
+void rotary_encoder_get_rate_info(ebtn_rate_info_t* info) {
+   rotary_encoder_engine_get_rate_info(&default_engine, info);
+}
+#endif
+
+#if CONFIG_EBTN_UNIFIED_TIMER
+void ebtn_sched_poll_encoders() {
+   poll(&default_engine);
+}
+#endif
+
+void rotary_encoder_engine_set_event_callback(rotary_encoder_engine_t* engine, rotary_encoder_event_cb_t event_callback) {
+   engine->event_callback = event_callback;
+}
+
+void rotary_encoder_engine_set_prepoll_callback(rotary_encoder_engine_t* engine, ebtn_prepoll_cb_t prepoll_callback) {
+   engine->prepoll_callback = prepoll_callback;
+}
+
+void rotary_encoder_engine_set_prepoll_async(rotary_encoder_engine_t* engine, ebtn_prepoll_async_t* prepoll) {
+   engine->prepoll_async = prepoll;
+}
+
+void rotary_encoder_set_event_callback(rotary_encoder_event_cb_t event_callback) {
+   rotary_encoder_engine_set_event_callback(&default_engine, event_callback);
 }
 
 void rotary_encoder_set_prepoll_callback(ebtn_prepoll_cb_t prepoll_callback) {
-   _prepoll_callback = prepoll_callback;
+   rotary_encoder_engine_set_prepoll_callback(&default_engine, prepoll_callback);
 }
 
-esp_err_t rotary_encoder_add(rotary_encoder_t* enc) {
-   ESP_RETURN_ON_FALSE(enc, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+void rotary_encoder_set_prepoll_async(ebtn_prepoll_async_t* prepoll) {
+   rotary_encoder_engine_set_prepoll_async(&default_engine, prepoll);
+}
+
+static void reset_encoder(rotary_encoder_t* enc) {
+   enc->internal.state = 0;
+
+#if CONFIG_EBTN_SNAPSHOT
+   enc->internal.position = limit_position(enc, 0);
+   ebtn_snapshot_set_position(enc->id, enc->internal.position);
+#endif
+
+#if CONFIG_EBTN_ENC_ISR
+   enc->internal.isr_steps = 0;
+   enc->internal.last_edge_us = ebtn_hal_time_us();
+   enc->internal.resample = false;
+#endif
+
+#if CONFIG_EBTN_ENC_COALESCE
+   enc->internal.steps = 0;
+   enc->internal.last_event_us = ebtn_hal_time_us();
+#endif
+
+#if CONFIG_EBTN_STATS
+   enc->internal.events_sent = 0;
+   enc->internal.events_dropped = 0;
+#endif
+}
+
+#if CONFIG_EBTN_COMPACT
+// Compact events only carry the id, so it must tell the encoders of an engine apart.
+// must be called while holding the mutex
+static bool id_in_use(rotary_encoder_engine_t* engine, const rotary_encoder_t* enc) {
+   uint16_t count = ebtn_registry_count(&engine->encoders);
+   _Atomic(void*)* items = ebtn_registry_items(&engine->encoders);
+   for (uint16_t i = 0; i < count; i++) {
+      const rotary_encoder_t* other = ebtn_registry_get(items, i);
+      if (other != enc && other->id == enc->id)
+         return true;
+   }
+
+   count = ebtn_registry_count(&engine->ports);
+   items = ebtn_registry_items(&engine->ports);
+   for (uint16_t i = 0; i < count; i++) {
+      const rotary_encoder_port_t* port = ebtn_registry_get(items, i);
+
+      ebtn_mask_t used = port->internal.used;
+      while (used) {
+         const rotary_encoder_t* other = port->internal.encoders[MASK_CTZ(used)];
+         used &= used - 1;
+
+         if (other != enc && other->id == enc->id)
+            return true;
+      }
+   }
+   return false;
+}
+#endif
+
+// must be called while holding the mutex
+static esp_err_t port_add_encoder(rotary_encoder_engine_t* engine, rotary_encoder_t* enc) {
+   rotary_encoder_port_t* port = enc->port;
+   const ebtn_mask_t bit = MASK_BIT(enc->pin_a);
+
+   if (port->internal.used & bit)
+      return port->internal.encoders[enc->pin_a] == enc ? ESP_ERR_INVALID_STATE : ESP_ERR_INVALID_ARG;
+
+   if (!port->internal.used) { // first encoder of this port, add port to the polling loop
+      port->internal.invert = 0;
+      port->internal.half = 0;
+      port->internal.quarter = 0;
+      port->internal.reset = 0;
+      port->internal.a = 0;
+      port->internal.b = 0;
+      port->internal.arm_cw = 0;
+      port->internal.arm_ccw = 0;
+#if CONFIG_EBTN_ENC_COALESCE
+      port->internal.pending = 0;
+#endif
+
+      // polled with nothing used until the bits below are published
+      const esp_err_t err = ebtn_registry_add(&engine->ports, port);
+      if (err != ESP_OK)
+         return err;
+
+      __atomic_store_n(&port->internal.engine, engine, __ATOMIC_RELEASE);
+   }
+
+   reset_encoder(enc);
+
+   // publish in the order port_poll() reads: encoder and config first, the used bit last
+   __atomic_store_n(&port->internal.encoders[enc->pin_a], enc, __ATOMIC_RELEASE);
+   if (enc->active_low) {
+      __atomic_fetch_or(&port->internal.invert, bit, __ATOMIC_RELEASE);
+   } else {
+      __atomic_fetch_and(&port->internal.invert, ~bit, __ATOMIC_RELEASE);
+   }
+   if (enc->step_mode == ROT_STEP_HALF) {
+      __atomic_fetch_or(&port->internal.half, bit, __ATOMIC_RELEASE);
+   } else {
+      __atomic_fetch_and(&port->internal.half, ~bit, __ATOMIC_RELEASE);
+   }
+   if (enc->step_mode == ROT_STEP_QUARTER) {
+      __atomic_fetch_or(&port->internal.quarter, bit, __ATOMIC_RELEASE);
+   } else {
+      __atomic_fetch_and(&port->internal.quarter, ~bit, __ATOMIC_RELEASE);
+   }
+   __atomic_fetch_or(&port->internal.reset, bit, __ATOMIC_RELEASE);
+   __atomic_fetch_or(&port->internal.used, bit, __ATOMIC_RELEASE);
+
+   return ESP_OK;
+}
+
+// must be called while holding the mutex
+static esp_err_t port_remove_encoder(rotary_encoder_engine_t* engine, rotary_encoder_t* enc) {
+   rotary_encoder_port_t* port = enc->port;
+   const ebtn_mask_t bit = MASK_BIT(enc->pin_a);
+
+   if (!(port->internal.used & bit) || port->internal.encoders[enc->pin_a] != enc || port->internal.engine != engine)
+      return ESP_ERR_INVALID_ARG;
+
+   __atomic_fetch_and(&port->internal.used, ~bit, __ATOMIC_RELEASE);
+   __atomic_store_n(&port->internal.encoders[enc->pin_a], NULL, __ATOMIC_RELEASE);
+
+   if (!port->internal.used) // last encoder of this port, remove port from the polling loop
+      return ebtn_registry_remove(&engine->ports, port);
+
+   ebtn_epoch_synchronize(&engine->epoch);
+   return ESP_OK;
+}
+
+#if CONFIG_EBTN_SNAPSHOT
+// must be called while holding the mutex
+static bool is_added(rotary_encoder_engine_t* engine, rotary_encoder_t* enc) {
+   if (enc->port)
+      return enc->port->internal.engine == engine && (enc->port->internal.used & MASK_BIT(enc->pin_a)) && enc->port->internal.encoders[enc->pin_a] == enc;
+   return ebtn_registry_contains(&engine->encoders, enc);
+}
+#endif
+
+esp_err_t rotary_encoder_engine_add(rotary_encoder_engine_t* engine, rotary_encoder_t* enc) {
+   ESP_RETURN_ON_FALSE(engine && enc, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+   ESP_RETURN_ON_FALSE(!enc->port || (enc->port->poll_port_callback && (unsigned)enc->pin_a < EBTN_MASK_BITS), ESP_ERR_INVALID_ARG, TAG,
+                       "Invalid port or port pin");
+   ESP_RETURN_ON_FALSE(enc->step_mode <= ROT_STEP_QUARTER, ESP_ERR_INVALID_ARG, TAG, "Invalid step mode");
+#if CONFIG_EBTN_COMPACT
+   ESP_RETURN_ON_FALSE(enc->id, ESP_ERR_INVALID_ARG, TAG, "Encoder id required with CONFIG_EBTN_COMPACT");
+#endif
 
    SEMAPHORE_TAKE();
 
-   esp_err_t ret = ESP_ERR_NO_MEM;
+   esp_err_t ret = ESP_OK;
 
-   for (uint8_t i = 0; i < CONFIG_EBTN_MAX_COUNT_ENC; i++) {
-      ESP_GOTO_ON_FALSE(encoders[i] != enc, ESP_ERR_INVALID_STATE, end, TAG, "Encoder already added");
+#if CONFIG_EBTN_COMPACT
+   ESP_GOTO_ON_FALSE(!id_in_use(engine, enc), ESP_ERR_INVALID_ARG, end, TAG, "Encoder id already in use");
+#endif
 
-      if (encoders[i])
-         continue;
+#if CONFIG_EBTN_SNAPSHOT
+   // snapshots are shared by all engines, an encoder already added fails below and keeps its id
+   bool claimed = false;
+   if (!is_added(engine, enc)) {
+      ESP_GOTO_ON_FALSE(ebtn_snapshot_claim_position(enc->id), ESP_ERR_INVALID_ARG, end, TAG, "Snapshot id already in use");
+      claimed = true;
+   }
+#endif
 
-      enc->internal.code = 0;
-      enc->internal.store = 0;
+   if (enc->port) {
+      ESP_GOTO_ON_FALSE(!enc->port->internal.used || enc->port->internal.engine == engine, ESP_ERR_INVALID_ARG, end, TAG, "Port polled by another engine");
 
-      if (!enc->poll_state_callback) {
-         esp_rom_gpio_pad_select_gpio(enc->pin_a);
-         ret = gpio_set_direction(enc->pin_a, GPIO_MODE_INPUT);
-         if (ret != ESP_OK)
-            break;
+      ret = port_add_encoder(engine, enc);
+      ESP_GOTO_ON_FALSE(ret != ESP_ERR_INVALID_STATE, ret, end, TAG, "Encoder already added");
+      ESP_GOTO_ON_FALSE(ret != ESP_ERR_INVALID_ARG, ret, end, TAG, "Port pin already in use");
+      goto end;
+   }
 
-         esp_rom_gpio_pad_select_gpio(enc->pin_b);
-         ret = gpio_set_direction(enc->pin_b, GPIO_MODE_INPUT);
-         if (ret != ESP_OK)
-            break;
+   ESP_GOTO_ON_FALSE(!ebtn_registry_contains(&engine->encoders, enc), ESP_ERR_INVALID_STATE, end, TAG, "Encoder already added");
+   ESP_GOTO_ON_FALSE(!ebtn_registry_full(&engine->encoders), ESP_ERR_NO_MEM, end, TAG, "Too many encoders");
 
-         if (enc->internal_pull) {
-            ret = gpio_set_pull_mode(enc->pin_a, enc->active_low ? GPIO_PULLUP_ONLY : GPIO_PULLDOWN_ONLY);
-            if (ret != ESP_OK)
-               break;
+   reset_encoder(enc);
 
-            ret = gpio_set_pull_mode(enc->pin_b, enc->active_low ? GPIO_PULLUP_ONLY : GPIO_PULLDOWN_ONLY);
-            if (ret != ESP_OK)
-               break;
-         }
+   if (!enc->poll_state_callback) {
+      ESP_GOTO_ON_ERROR(ebtn_hal_gpio_input_init(enc->pin_a, enc->internal_pull, enc->active_low), end, TAG, "Failed to init encoder GPIO");
+      ESP_GOTO_ON_ERROR(ebtn_hal_gpio_input_init(enc->pin_b, enc->internal_pull, enc->active_low), end, TAG, "Failed to init encoder GPIO");
+      enc->poll_state_callback = ebtn_hal_gpio_get_level;
+   }
 
-         enc->poll_state_callback = gpio_encoder_poll_state;
-      }
+#if CONFIG_EBTN_ENC_ISR
+   if (ISR_DRIVEN(enc)) {
+      enc->internal.engine = engine; // woken by steps
+      ESP_GOTO_ON_ERROR(ebtn_hal_gpio_isr_add(enc->pin_a, edge_isr, enc), end, TAG, "Failed to add encoder GPIO interrupt");
 
-      encoders[i] = enc;
-      ret = ESP_OK;
-      break;
+      ret = ebtn_hal_gpio_isr_add(enc->pin_b, edge_isr, enc);
+      if (ret == ESP_OK)
+         ret = ebtn_registry_add(&engine->encoders, enc);
+
+      if (ret != ESP_OK) {
+         ebtn_hal_gpio_isr_remove(enc->pin_a);
+         ebtn_hal_gpio_isr_remove(enc->pin_b);
+      }
+      goto end;
    }
+#endif
+
+   ret = ebtn_registry_add(&engine->encoders, enc);
 
 end:
+#if CONFIG_EBTN_SNAPSHOT
+   if (ret != ESP_OK && claimed)
+      ebtn_snapshot_release_position(enc->id);
+#endif
+
    SEMAPHORE_GIVE();
+
+#if CONFIG_EBTN_ENC_ISR
+   if (ret == ESP_OK)
+      encoder_wake(engine); // sampled encoders and ports need the timer
+#endif
+
    return ret;
 }
 
-esp_err_t rotary_encoder_remove(rotary_encoder_t* enc) {
-   ESP_RETURN_ON_FALSE(enc, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+esp_err_t rotary_encoder_engine_remove(rotary_encoder_engine_t* engine, rotary_encoder_t* enc) {
+   ESP_RETURN_ON_FALSE(engine && enc, ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
 
    SEMAPHORE_TAKE();
 
-   esp_err_t err = ESP_ERR_INVALID_ARG;
-
-   for (uint8_t i = 0; i < CONFIG_EBTN_MAX_COUNT_ENC; i++) {
-      if (encoders[i] != enc)
-         continue;
-
-      encoders[i] = NULL;
+   esp_err_t err;
 
-      err = ESP_OK;
-      break;
+   if (enc->port) {
+      err = port_remove_encoder(engine, enc);
+   } else {
+#if CONFIG_EBTN_ENC_ISR
+      // interrupts touch the encoder, so detach them before it can be freed
+      if (ISR_DRIVEN(enc) && ebtn_registry_contains(&engine->encoders, enc)) {
+         ebtn_hal_gpio_isr_remove(enc->pin_a);
+         ebtn_hal_gpio_isr_remove(enc->pin_b);
+      }
+#endif
+      err = ebtn_registry_remove(&engine->encoders, enc);
    }
 
+#if CONFIG_EBTN_SNAPSHOT
+   if (err == ESP_OK)
+      ebtn_snapshot_release_position(enc->id);
+#endif
+
    SEMAPHORE_GIVE();
 
    return err;
-}
\ No newline at end of file
+}
+
+esp_err_t rotary_encoder_add(rotary_encoder_t* enc) {
+   return rotary_encoder_engine_add(&default_engine, enc);
+}
+
+esp_err_t rotary_encoder_remove(rotary_encoder_t* enc) {
+   return rotary_encoder_engine_remove(&default_engine, enc);
+}
@@ -0,0 +1,126 @@
+/*
+ * Button example using a pipelined (async) pre-poll, with a simulated port expander.
+ * See menuconfig for library options, enable CONFIG_EBTN_STATS to compare poll times of both modes.
+ */
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_rom_sys.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <button.h>
+#include <ebtn.h>
+
+#define EXPANDER_LATENCY_US 150 // time a read takes on the bus (e.g. PCF8574 at 100kHz)
+#define PIPELINED 1             // 0 to read synchronously from the pre-poll callback instead
+
+static const char* BUTTON_STATE_NAMES[] = {
+    [BUTTON_PRESSED] = "pressed",   //
+    [BUTTON_RELEASED] = "released", //
+    [BUTTON_CLICKED] = "clicked",   //
+    [BUTTON_PRESSED_LONG] = "long press",
+};
+
+static const gpio_num_t PINS[] = {GPIO_NUM_32, GPIO_NUM_33, GPIO_NUM_34, GPIO_NUM_35};
+
+// Simulated expander, "reads" the pins after EXPANDER_LATENCY_US like an interrupt driven bus transaction would
+static esp_timer_handle_t expander_timer;
+static uint8_t* expander_dst;
+
+static uint8_t expander_sample() {
+   uint8_t data = 0;
+   for (uint8_t i = 0; i < sizeof(PINS) / sizeof(PINS[0]); i++)
+      data |= gpio_get_level(PINS[i]) << i;
+   return data;
+}
+
+#if PIPELINED
+static uint8_t port_data[2];
+
+static void expander_complete(void* arg) {
+   *expander_dst = expander_sample();
+   ebtn_prepoll_async_done(arg);
+}
+
+static void expander_start(ebtn_prepoll_async_t* prepoll, void* buf) {
+   expander_dst = buf;
+   esp_timer_start_once(expander_timer, EXPANDER_LATENCY_US); // returns immediately, the bus works in the background
+}
+
+static ebtn_prepoll_async_t prepoll = {.start = expander_start, .buf = {&port_data[0], &port_data[1]}};
+
+static uint8_t poll_state(gpio_num_t pin) {
+   return (*(const uint8_t*)ebtn_prepoll_async_data(&prepoll) >> pin) & 1;
+}
+#else
+static uint8_t port_data;
+
+static void prepoll_callback() {
+   esp_rom_delay_us(EXPANDER_LATENCY_US); // blocks the esp_timer task for the whole transaction
+   port_data = expander_sample();
+}
+
+static uint8_t poll_state(gpio_num_t pin) {
+   return (port_data >> pin) & 1;
+}
+#endif
+
+// Define buttons, pin is the bit within the expander port, ids tell them apart in events
+static button_t btn1 = {.id = 1, .pin = 0, .active_low = true, .poll_state_callback = poll_state};
+static button_t btn2 = {.id = 2, .pin = 1, .active_low = true, .poll_state_callback = poll_state};
+static button_t btn3 = {.id = 3, .pin = 2, .active_low = true, .poll_state_callback = poll_state};
+static button_t btn4 = {.id = 4, .pin = 3, .active_low = true, .poll_state_callback = poll_state};
+
+static QueueHandle_t btn_event_queue;
+
+static void button_task(void* pvParameter) {
+   btn_event_queue = xQueueCreate(5, sizeof(button_event_t));
+
+   for (uint8_t i = 0; i < sizeof(PINS) / sizeof(PINS[0]); i++) {
+      gpio_set_direction(PINS[i], GPIO_MODE_INPUT);
+      gpio_set_pull_mode(PINS[i], GPIO_PULLUP_ONLY);
+   }
+
+#if PIPELINED
+   const esp_timer_create_args_t args = {.callback = expander_complete, .arg = &prepoll, .dispatch_method = ESP_TIMER_TASK, .name = "expander"};
+   ESP_ERROR_CHECK(esp_timer_create(&args, &expander_timer));
+
+   // Each poll decodes the last completed read and starts the next one, so the esp_timer task is never blocked on the bus.
+   button_set_prepoll_async(&prepoll);
+#else
+   button_set_prepoll_callback(prepoll_callback);
+#endif
+
+   ESP_ERROR_CHECK(button_init(btn_event_queue)); // Init button library with event queue
+   ESP_ERROR_CHECK(button_add(&btn1));            // Add buttons...
+   ESP_ERROR_CHECK(button_add(&btn2));
+   ESP_ERROR_CHECK(button_add(&btn3));
+   ESP_ERROR_CHECK(button_add(&btn4));
+
+   button_event_t e;
+   while (true) {
+      if (xQueueReceive(btn_event_queue, &e, pdMS_TO_TICKS(5000))) { // Block until button event is available
+         printf("Button %u was %s, %u times\n", button_event_id(&e), BUTTON_STATE_NAMES[e.type], e.count);
+         continue;
+      }
+
+#if CONFIG_EBTN_STATS
+      ebtn_stats_t stats;
+      ebtn_get_stats(&stats);
+      printf("Polls %" PRIu32 ", avg %" PRIu64 " us, max %" PRIu32 " us\n", stats.buttons.polls, stats.buttons.time_total_us / stats.buttons.polls,
+             stats.buttons.time_max_us);
+#endif
+#if PIPELINED
+      printf("Expander overruns %" PRIu32 "\n", prepoll.internal.overruns);
+#endif
+   }
+
+   ESP_ERROR_CHECK(button_free()); // Cleanup button library
+   vQueueDelete(btn_event_queue);
+}
+
+void app_main() {
+   xTaskCreate(button_task, "button_task", configMINIMAL_STACK_SIZE * 3, NULL, 5, NULL);
+}
@@ -17,11 +17,11 @@ static const char* BUTTON_STATE_NAMES[] = {
     [BUTTON_PRESSED_LONG] = "long press",
 };
 
-// Define buttons
-static button_t btn1 = {.pin = GPIO_NUM_32, .active_low = true};
-static button_t btn2 = {.pin = GPIO_NUM_33, .active_low = true};
-static button_t btn3 = {.pin = GPIO_NUM_34, .active_low = true};
-static button_t btn4 = {.pin = GPIO_NUM_35, .active_low = true};
+// Define buttons, ids tell them apart in events (required with CONFIG_EBTN_COMPACT)
+static button_t btn1 = {.id = 1, .pin = GPIO_NUM_32, .active_low = true};
+static button_t btn2 = {.id = 2, .pin = GPIO_NUM_33, .active_low = true};
+static button_t btn3 = {.id = 3, .pin = GPIO_NUM_34, .active_low = true};
+static button_t btn4 = {.id = 4, .pin = GPIO_NUM_35, .active_low = true};
 
 static QueueHandle_t btn_event_queue;
 
@@ -38,21 +38,12 @@ static void button_task(void* pvParameter) {
     while (true) {
         xQueueReceive(btn_event_queue, &e, portMAX_DELAY);  // Block until button event is available
 
-        uint8_t idx = 0; 
-        if (e.sender == &btn1) {
-            idx = 1;
-        } else if (e.sender == &btn2) {
-            idx = 2;
-        } else if (e.sender == &btn3) {
-            idx = 3;
-        } else if (e.sender == &btn4) {
-            idx = 4;
-        }
+        const uint8_t idx = button_event_id(&e);
 
         if (e.count > 1) {
             printf("Button %u was %s, %u times\n", idx, BUTTON_STATE_NAMES[e.type], e.count);
         } else {
-            printf("Button %u was %s, %u times - delta %" PRIu32 " ms\n", idx, BUTTON_STATE_NAMES[e.type], e.count, e.delta_ms);
+            printf("Button %u was %s, %u times - delta %" PRIu32 " ms\n", idx, BUTTON_STATE_NAMES[e.type], e.count, button_event_delta_ms(&e));
         }
     }
 
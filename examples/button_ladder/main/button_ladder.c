@@ -0,0 +1,79 @@
+/*
+ * Button example using a resistor ladder, 4 buttons on a single ADC pin (GPIO34, ADC1 channel 6).
+ * Released, the pin is pulled up to 3.3V. Each button pulls it down through a different resistor.
+ * See menuconfig for library options.
+ */
+#include <esp_log.h>
+#include <esp_adc/adc_oneshot.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <button.h>
+#include <button_ladder.h>
+
+#define BUTTONS 4
+
+static const char* BUTTON_STATE_NAMES[] = {
+    [BUTTON_PRESSED] = "pressed",   //
+    [BUTTON_RELEASED] = "released", //
+    [BUTTON_CLICKED] = "clicked",   //
+    [BUTTON_PRESSED_LONG] = "long press",
+};
+
+// Raw 12 bit readings of each button, measure these on the actual panel
+static const uint16_t LEVELS[BUTTONS] = {0, 820, 1640, 2460};
+
+static adc_oneshot_unit_handle_t adc;
+
+static uint16_t sample(button_ladder_t* ladder) {
+   int raw = 4095; // reads as released on error
+   adc_oneshot_read(adc, ADC_CHANNEL_6, &raw);
+   return raw;
+}
+
+static button_ladder_t ladder = {
+    .count = BUTTONS,
+    .levels = LEVELS,
+    .idle_level = 4095,
+    .hysteresis = 100,
+    .sample_callback = sample,
+    .port = {.debounce = true}, // also filters the short transitions while the voltage settles
+};
+
+static button_t buttons[BUTTONS];
+
+static QueueHandle_t btn_event_queue;
+
+static void button_task(void* pvParameter) {
+   btn_event_queue = xQueueCreate(5, sizeof(button_event_t));
+
+   const adc_oneshot_unit_init_cfg_t unit_cfg = {.unit_id = ADC_UNIT_1};
+   ESP_ERROR_CHECK(adc_oneshot_new_unit(&unit_cfg, &adc));
+
+   const adc_oneshot_chan_cfg_t chan_cfg = {.atten = ADC_ATTEN_DB_12, .bitwidth = ADC_BITWIDTH_12};
+   ESP_ERROR_CHECK(adc_oneshot_config_channel(adc, ADC_CHANNEL_6, &chan_cfg));
+
+   ESP_ERROR_CHECK(button_init(btn_event_queue)); // Init button library with event queue
+   ESP_ERROR_CHECK(button_ladder_init(&ladder));   // Init ladder port
+
+   for (uint8_t i = 0; i < BUTTONS; i++) {
+      buttons[i] = (button_t){.id = i + 1, .port = &ladder.port, .pin = i};
+      ESP_ERROR_CHECK(button_add(&buttons[i]));
+   }
+
+   button_event_t e;
+   while (true) {
+      xQueueReceive(btn_event_queue, &e, portMAX_DELAY); // Block until button event is available
+
+      printf("Button %u was %s, %u times\n", (unsigned)(button_event_id(&e) - 1), BUTTON_STATE_NAMES[e.type], e.count);
+   }
+
+   ESP_ERROR_CHECK(button_free()); // Cleanup button library
+   vQueueDelete(btn_event_queue);
+}
+
+void app_main() {
+   xTaskCreate(button_task, "button_task", configMINIMAL_STACK_SIZE * 3, NULL, 5, NULL);
+}
@@ -0,0 +1,85 @@
+/*
+ * Button example using a 4x4 key matrix without diodes (e.g. a membrane keypad).
+ * Rows are driven low one at a time (open drain), columns are read with internal pullups.
+ * See menuconfig for library options.
+ */
+#include <esp_log.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <button.h>
+#include <button_matrix.h>
+
+#define ROWS 4
+#define COLS 4
+
+static const char* BUTTON_STATE_NAMES[] = {
+    [BUTTON_PRESSED] = "pressed",   //
+    [BUTTON_RELEASED] = "released", //
+    [BUTTON_CLICKED] = "clicked",   //
+    [BUTTON_PRESSED_LONG] = "long press",
+};
+
+static const char KEY_NAMES[ROWS][COLS] = {
+    {'1', '2', '3', 'A'},
+    {'4', '5', '6', 'B'},
+    {'7', '8', '9', 'C'},
+    {'*', '0', '#', 'D'},
+};
+
+static const gpio_num_t ROW_PINS[ROWS] = {GPIO_NUM_16, GPIO_NUM_17, GPIO_NUM_18, GPIO_NUM_19};
+static const gpio_num_t COL_PINS[COLS] = {GPIO_NUM_21, GPIO_NUM_22, GPIO_NUM_23, GPIO_NUM_25};
+
+static button_matrix_t matrix = {
+    .rows = ROWS,
+    .cols = COLS,
+    .row_pins = ROW_PINS,
+    .col_pins = COL_PINS,
+    .internal_pull = true,
+    .active_low = true,
+    .diodes = false,          // block ghosted keys
+    .scan_interval_us = 5000, // scanned independently of the button polling interval
+    .settle_us = 5,
+    .port = {.debounce = true},
+};
+
+static button_t keys[ROWS][COLS];
+
+static QueueHandle_t btn_event_queue;
+
+static void button_task(void* pvParameter) {
+   btn_event_queue = xQueueCreate(10, sizeof(button_event_t));
+
+   ESP_ERROR_CHECK(button_init(btn_event_queue)); // Init button library with event queue
+   ESP_ERROR_CHECK(button_matrix_init(&matrix));   // Init matrix pins and start scanning
+
+   // Every key is a regular button attached to the matrix port
+   for (uint8_t row = 0; row < ROWS; row++) {
+      for (uint8_t col = 0; col < COLS; col++) {
+         keys[row][col] = (button_t){.id = row * COLS + col + 1, .port = &matrix.port, .pin = button_matrix_key(&matrix, row, col)};
+         ESP_ERROR_CHECK(button_add(&keys[row][col]));
+      }
+   }
+
+   button_event_t e;
+   while (true) {
+      xQueueReceive(btn_event_queue, &e, portMAX_DELAY); // Block until button event is available
+
+      const uint8_t idx = button_event_id(&e) - 1;
+      printf("Key %c was %s, %u times\n", KEY_NAMES[idx / COLS][idx % COLS], BUTTON_STATE_NAMES[e.type], e.count);
+   }
+
+   for (uint8_t row = 0; row < ROWS; row++)
+      for (uint8_t col = 0; col < COLS; col++)
+         ESP_ERROR_CHECK(button_remove(&keys[row][col]));
+
+   ESP_ERROR_CHECK(button_matrix_free(&matrix));
+   ESP_ERROR_CHECK(button_free()); // Cleanup button library
+   vQueueDelete(btn_event_queue);
+}
+
+void app_main() {
+   xTaskCreate(button_task, "button_task", configMINIMAL_STACK_SIZE * 3, NULL, 5, NULL);
+}
@@ -0,0 +1,78 @@
+/*
+ * Example using separate engines: panel buttons polled slowly, encoders polled fast, each with its own queue.
+ * 4 active low panel buttons on GPIO 32, 33, 25, 26 and 2 encoders on GPIO 16/17 and 18/19.
+ * See menuconfig for library options.
+ */
+#include <esp_log.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <button.h>
+#include <encoder.h>
+
+#define BUTTONS 4
+#define ENCODERS 2
+
+static const gpio_num_t BUTTON_PINS[BUTTONS] = {GPIO_NUM_32, GPIO_NUM_33, GPIO_NUM_25, GPIO_NUM_26};
+static const gpio_num_t ENCODER_PINS[ENCODERS][2] = {{GPIO_NUM_16, GPIO_NUM_17}, {GPIO_NUM_18, GPIO_NUM_19}};
+
+static button_t buttons[BUTTONS];
+static rotary_encoder_t encoders[ENCODERS];
+
+static button_engine_t* panel;
+static rotary_encoder_engine_t* knobs;
+
+static QueueHandle_t btn_event_queue;
+static QueueHandle_t enc_event_queue;
+
+static void button_task(void* pvParameter) {
+   button_event_t e;
+   while (true) {
+      xQueueReceive(btn_event_queue, &e, portMAX_DELAY); // Block until button event is available
+
+      if (e.type == BUTTON_CLICKED)
+         printf("Button %u clicked %u times\n", (unsigned)(button_event_id(&e) - 1), e.count);
+   }
+}
+
+static void encoder_task(void* pvParameter) {
+   int16_t pos[ENCODERS] = {0};
+
+   rotary_encoder_event_t e;
+   while (true) {
+      xQueueReceive(enc_event_queue, &e, portMAX_DELAY); // Block until encoder event is available
+
+      const uint8_t idx = rotary_encoder_event_id(&e) - 1;
+      pos[idx] += e.dir;
+
+      printf("Encoder %u: %d\n", idx, pos[idx]);
+   }
+}
+
+void app_main() {
+   btn_event_queue = xQueueCreate(5, sizeof(button_event_t));
+   enc_event_queue = xQueueCreate(20, sizeof(rotary_encoder_event_t));
+
+   // a panel doesn't need the default 10ms polling
+   const button_engine_config_t panel_config = {.queue = btn_event_queue, .interval_us = 25000, .max_buttons = BUTTONS};
+   ESP_ERROR_CHECK(button_engine_create(&panel_config, &panel));
+
+   // fast knobs need more than the default 1ms polling
+   const rotary_encoder_engine_config_t knobs_config = {.queue = enc_event_queue, .interval_us = 250, .max_encoders = ENCODERS};
+   ESP_ERROR_CHECK(rotary_encoder_engine_create(&knobs_config, &knobs));
+
+   for (uint8_t i = 0; i < BUTTONS; i++) {
+      buttons[i] = (button_t){.id = i + 1, .pin = BUTTON_PINS[i], .internal_pull = true, .active_low = true};
+      ESP_ERROR_CHECK(button_engine_add(panel, &buttons[i]));
+   }
+
+   for (uint8_t i = 0; i < ENCODERS; i++) {
+      encoders[i] = (rotary_encoder_t){.id = i + 1, .pin_a = ENCODER_PINS[i][0], .pin_b = ENCODER_PINS[i][1], .internal_pull = true, .active_low = true};
+      ESP_ERROR_CHECK(rotary_encoder_engine_add(knobs, &encoders[i]));
+   }
+
+   xTaskCreate(button_task, "button_task", configMINIMAL_STACK_SIZE * 3, NULL, 5, NULL);
+   xTaskCreate(encoder_task, "encoder_task", configMINIMAL_STACK_SIZE * 3, NULL, 5, NULL);
+}
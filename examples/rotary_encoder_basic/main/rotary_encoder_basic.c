@@ -12,10 +12,11 @@
 #include <encoder.h>
 
 // Define encoder button (see button examples for button setup)
-static button_t btn_enc = {.pin = GPIO_NUM_32, .active_low = true};
+static button_t btn_enc = {.id = 1, .pin = GPIO_NUM_32, .active_low = true};
 
 // Rotary encoder with button
 static rotary_encoder_t enc = {
+    .id = 1,
     .btn = &btn_enc,
     .pin_a = GPIO_NUM_33,
     .pin_b = GPIO_NUM_34,
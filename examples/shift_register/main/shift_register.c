@@ -0,0 +1,91 @@
+/*
+ * Button and encoder example using a chain of two 74HC165 shift registers, bit-banged from GPIOs.
+ * The first register holds 8 active low buttons, the second 4 active low encoders (A/B on adjacent inputs).
+ * See menuconfig for library options, with CONFIG_EBTN_UNIFIED_TIMER the chain can be read once per tick for both.
+ */
+#include <esp_log.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <button.h>
+#include <encoder.h>
+#include <shift_register.h>
+
+#define BUTTONS 8
+#define ENCODERS 4
+
+static uint8_t chain_buf[2];
+
+static shift_register_t chain = {
+    .inputs = 16,
+    .buf = chain_buf,
+    .load_pin = GPIO_NUM_25,
+    .clock_pin = GPIO_NUM_26,
+    .data_pin = GPIO_NUM_27,
+};
+
+// port numbers are the first byte of the chain read by the port
+static button_port_t btn_port = {.poll_port_callback = shift_register_poll_button_port, .port = 0, .ctx = &chain, .debounce = true};
+static rotary_encoder_port_t enc_port = {.poll_port_callback = shift_register_poll_encoder_port, .port = 1, .ctx = &chain};
+
+static button_t buttons[BUTTONS];
+static rotary_encoder_t encoders[ENCODERS];
+
+static void prepoll_callback() {
+   shift_register_update(&chain); // clocks the whole chain in at once
+}
+
+static QueueHandle_t btn_event_queue;
+static QueueHandle_t enc_event_queue;
+
+static void button_task(void* pvParameter) {
+   button_event_t e;
+   while (true) {
+      xQueueReceive(btn_event_queue, &e, portMAX_DELAY); // Block until button event is available
+
+      if (e.type == BUTTON_CLICKED)
+         printf("Button %u clicked %u times\n", (unsigned)(button_event_id(&e) - 1), e.count);
+   }
+}
+
+static void encoder_task(void* pvParameter) {
+   int16_t pos[ENCODERS] = {0};
+
+   rotary_encoder_event_t e;
+   while (true) {
+      xQueueReceive(enc_event_queue, &e, portMAX_DELAY); // Block until encoder event is available
+
+      const uint8_t idx = rotary_encoder_event_id(&e) - 1;
+      pos[idx] += e.dir;
+
+      printf("Encoder %u: %d\n", idx, pos[idx]);
+   }
+}
+
+void app_main() {
+   btn_event_queue = xQueueCreate(10, sizeof(button_event_t));
+   enc_event_queue = xQueueCreate(10, sizeof(rotary_encoder_event_t));
+
+   ESP_ERROR_CHECK(shift_register_init(&chain));
+
+   button_set_prepoll_callback(prepoll_callback);
+   rotary_encoder_set_prepoll_callback(prepoll_callback);
+
+   ESP_ERROR_CHECK(button_init(btn_event_queue));
+   ESP_ERROR_CHECK(rotary_encoder_init(enc_event_queue));
+
+   for (uint8_t i = 0; i < BUTTONS; i++) {
+      buttons[i] = (button_t){.id = i + 1, .port = &btn_port, .pin = i, .active_low = true};
+      ESP_ERROR_CHECK(button_add(&buttons[i]));
+   }
+
+   for (uint8_t i = 0; i < ENCODERS; i++) {
+      encoders[i] = (rotary_encoder_t){.id = i + 1, .port = &enc_port, .pin_a = i, .active_low = true};
+      ESP_ERROR_CHECK(rotary_encoder_add(&encoders[i]));
+   }
+
+   xTaskCreate(button_task, "button_task", configMINIMAL_STACK_SIZE * 3, NULL, 5, NULL);
+   xTaskCreate(encoder_task, "encoder_task", configMINIMAL_STACK_SIZE * 3, NULL, 5, NULL);
+}
@@ -0,0 +1,234 @@
+#include "ebtn_hal.h"
+#include "ebtn.h"
+
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <esp_rom_sys.h>
+#include <driver/gpio.h>
+
+#if CONFIG_EBTN_POLL_TASK
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdlib.h>
+#endif
+
+static ebtn_clock_cb_t _clock = esp_timer_get_time;
+
+void ebtn_set_clock(ebtn_clock_cb_t clock) {
+   _clock = clock ? clock : esp_timer_get_time;
+}
+
+int64_t IRAM_ATTR ebtn_hal_time_us() {
+   return _clock();
+}
+
+esp_err_t ebtn_hal_gpio_input_init(gpio_num_t pin, bool internal_pull, bool active_low) {
+   esp_rom_gpio_pad_select_gpio(pin);
+
+   esp_err_t ret = gpio_set_direction(pin, GPIO_MODE_INPUT);
+   if (ret != ESP_OK || !internal_pull)
+      return ret;
+
+   return gpio_set_pull_mode(pin, active_low ? GPIO_PULLUP_ONLY : GPIO_PULLDOWN_ONLY);
+}
+
+uint8_t IRAM_ATTR ebtn_hal_gpio_get_level(gpio_num_t pin) {
+   return gpio_get_level(pin);
+}
+
+esp_err_t ebtn_hal_gpio_output_init(gpio_num_t pin, bool open_drain, uint8_t level) {
+   esp_rom_gpio_pad_select_gpio(pin);
+
+   esp_err_t ret = gpio_set_level(pin, level); // before enabling the output, to avoid a glitch
+   if (ret != ESP_OK)
+      return ret;
+
+   return gpio_set_direction(pin, open_drain ? GPIO_MODE_OUTPUT_OD : GPIO_MODE_OUTPUT);
+}
+
+void ebtn_hal_gpio_set_level(gpio_num_t pin, uint8_t level) {
+   gpio_set_level(pin, level);
+}
+
+void ebtn_hal_delay_us(uint32_t us) {
+   esp_rom_delay_us(us);
+}
+
+esp_err_t ebtn_hal_gpio_isr_add(gpio_num_t pin, ebtn_hal_cb_t handler, void* arg) {
+   esp_err_t ret = gpio_install_isr_service(0);
+   if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) // already installed by application
+      return ret;
+
+   ret = gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+   if (ret != ESP_OK)
+      return ret;
+
+   return gpio_isr_handler_add(pin, handler, arg);
+}
+
+esp_err_t ebtn_hal_gpio_isr_remove(gpio_num_t pin) {
+   gpio_set_intr_type(pin, GPIO_INTR_DISABLE);
+   return gpio_isr_handler_remove(pin);
+}
+
+#if CONFIG_EBTN_POLL_TASK
+// in internal RAM, as it's also used from interrupts
+struct ebtn_hal_timer {
+   esp_timer_handle_t timer; // runs the callback, or wakes the task
+   TaskHandle_t task;        // runs the callback if set, cleared once the task exits
+   ebtn_hal_cb_t callback;   // cleared to make the task exit
+   void* arg;
+};
+
+#define ESP_TIMER(timer) ((timer)->timer)
+
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+#define WAKE_DISPATCH ESP_TIMER_ISR
+#else
+#define WAKE_DISPATCH ESP_TIMER_TASK
+#endif
+
+static void IRAM_ATTR wake_task(void* arg) {
+   struct ebtn_hal_timer* timer = arg;
+
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+   BaseType_t woken = pdFALSE;
+   vTaskNotifyGiveFromISR(timer->task, &woken);
+   if (woken)
+      esp_timer_isr_dispatch_need_yield();
+#else
+   xTaskNotifyGive(timer->task);
+#endif
+}
+
+static void run_task(void* arg) {
+   struct ebtn_hal_timer* timer = arg;
+
+   while (true) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+      const ebtn_hal_cb_t callback = __atomic_load_n(&timer->callback, __ATOMIC_ACQUIRE);
+      if (!callback)
+         break;
+
+      callback(timer->arg);
+   }
+
+   __atomic_store_n(&timer->task, NULL, __ATOMIC_RELEASE); // timer can be freed from here on
+   vTaskDelete(NULL);
+}
+
+static esp_err_t timer_alloc(ebtn_hal_cb_t callback, void* arg, ebtn_hal_timer_t* out_timer) {
+   struct ebtn_hal_timer* timer = heap_caps_calloc(1, sizeof(struct ebtn_hal_timer), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+   if (!timer)
+      return ESP_ERR_NO_MEM;
+
+   timer->callback = callback;
+   timer->arg = arg;
+
+   *out_timer = timer;
+   return ESP_OK;
+}
+
+esp_err_t ebtn_hal_timer_create(const char* name, ebtn_hal_cb_t callback, void* arg, ebtn_hal_timer_t* out_timer) {
+   ebtn_hal_timer_t timer;
+   esp_err_t ret = timer_alloc(callback, arg, &timer);
+   if (ret != ESP_OK)
+      return ret;
+
+   const esp_timer_create_args_t args = {
+       .arg = arg,
+       .name = name,
+       .dispatch_method = ESP_TIMER_TASK,
+       .callback = callback,
+   };
+
+   ret = esp_timer_create(&args, &timer->timer);
+   if (ret != ESP_OK) {
+      free(timer);
+      return ret;
+   }
+
+   *out_timer = timer;
+   return ESP_OK;
+}
+
+esp_err_t ebtn_hal_timer_create_task(const char* name, ebtn_hal_cb_t callback, void* arg, const ebtn_task_config_t* task, ebtn_hal_timer_t* out_timer) {
+   ebtn_hal_timer_t timer;
+   esp_err_t ret = timer_alloc(callback, arg, &timer);
+   if (ret != ESP_OK)
+      return ret;
+
+   const BaseType_t core = task->core < 0 ? tskNO_AFFINITY : task->core;
+   if (xTaskCreatePinnedToCore(run_task, name, task->stack_size, timer, task->priority, &timer->task, core) != pdPASS) {
+      free(timer);
+      return ESP_ERR_NO_MEM;
+   }
+
+   const esp_timer_create_args_t args = {
+       .arg = timer,
+       .name = name,
+       .dispatch_method = WAKE_DISPATCH,
+       .callback = wake_task,
+   };
+
+   ret = esp_timer_create(&args, &timer->timer);
+   if (ret != ESP_OK) {
+      ebtn_hal_timer_delete(timer);
+      return ret;
+   }
+
+   *out_timer = timer;
+   return ESP_OK;
+}
+
+esp_err_t ebtn_hal_timer_delete(ebtn_hal_timer_t timer) {
+   esp_err_t ret = ESP_OK;
+   if (timer->timer) {
+      esp_timer_stop(timer->timer);
+      ret = esp_timer_delete(timer->timer);
+   }
+
+   if (timer->task) {
+      // let a callback that is still running finish, rather than deleting the task in the middle of it
+      __atomic_store_n(&timer->callback, NULL, __ATOMIC_RELEASE);
+      xTaskNotifyGive(timer->task);
+      while (__atomic_load_n(&timer->task, __ATOMIC_ACQUIRE))
+         vTaskDelay(1);
+   }
+
+   free(timer);
+   return ret;
+}
+#else
+#define ESP_TIMER(timer) ((esp_timer_handle_t)(timer))
+
+esp_err_t ebtn_hal_timer_create(const char* name, ebtn_hal_cb_t callback, void* arg, ebtn_hal_timer_t* out_timer) {
+   const esp_timer_create_args_t args = {
+       .arg = arg,
+       .name = name,
+       .dispatch_method = ESP_TIMER_TASK,
+       .callback = callback,
+   };
+
+   return esp_timer_create(&args, (esp_timer_handle_t*)out_timer);
+}
+
+esp_err_t ebtn_hal_timer_delete(ebtn_hal_timer_t timer) {
+   esp_timer_stop(ESP_TIMER(timer));
+   return esp_timer_delete(ESP_TIMER(timer));
+}
+#endif
+
+esp_err_t IRAM_ATTR ebtn_hal_timer_start_periodic(ebtn_hal_timer_t timer, uint64_t period_us) {
+   return esp_timer_start_periodic(ESP_TIMER(timer), period_us);
+}
+
+esp_err_t ebtn_hal_timer_restart(ebtn_hal_timer_t timer, uint64_t period_us) {
+   return esp_timer_restart(ESP_TIMER(timer), period_us);
+}
+
+esp_err_t IRAM_ATTR ebtn_hal_timer_stop(ebtn_hal_timer_t timer) {
+   return esp_timer_stop(ESP_TIMER(timer));
+}
@@ -1,9 +1,11 @@
 #ifndef _EBTN_BUTTON_H
 #define _EBTN_BUTTON_H
 
+#include <sdkconfig.h>
 #include <esp_err.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/task.h>
 #include <driver/gpio.h>
 
 #ifdef __cplusplus
@@ -22,27 +24,187 @@ typedef uint8_t (*ebtn_poll_state_cb_t)(gpio_num_t pin);
 
 typedef void (*ebtn_prepoll_cb_t)();
 
+typedef struct ebtn_prepoll_async ebtn_prepoll_async_t;
+
+/**
+ * @brief Async pre-poll callback prototype
+ *
+ * Starts reading the port data into buf without waiting for it (e.g. queues an I2C/SPI transaction), and arranges for
+ * ebtn_prepoll_async_done() to be called once buf holds the data.
+ *
+ * @param prepoll The async pre-poll the read belongs to
+ * @param buf The buffer to read into, one of prepoll->buf
+ */
+typedef void (*ebtn_prepoll_start_cb_t)(ebtn_prepoll_async_t* prepoll, void* buf);
+
+/**
+ * Pipelined pre-poll, for port expanders too slow to read synchronously from the polling timer.
+ *
+ * Each poll decodes the last completed read (see ebtn_prepoll_async_data()) and starts the next one, so state lags by one
+ * polling interval. If a read is still in flight at the next poll, no new read is started and the last completed data is
+ * decoded again.
+ */
+struct ebtn_prepoll_async {
+   ebtn_prepoll_start_cb_t start; // required
+   void* buf[2];                  // two buffers of the port data, buf[0] is decoded until the first read completes
+   void* ctx;
+
+   struct {
+      uint8_t front;     // buffer of the last completed read
+      bool in_flight;    // a read was started and not yet swapped in
+      bool done;         // read completed, set by ebtn_prepoll_async_done()
+      uint32_t overruns; // polls that found the previous read still in flight
+   } internal;
+};
+
+/**
+ * @brief Returns the data of the last completed read, for port and pin state callbacks
+ */
+static inline const void* ebtn_prepoll_async_data(const ebtn_prepoll_async_t* prepoll) {
+   return prepoll->buf[prepoll->internal.front];
+}
+
+/**
+ * @brief Signals completion of the read started by the async pre-poll callback
+ *
+ * Safe to call from ISR context, or from within the async pre-poll callback itself.
+ */
+void ebtn_prepoll_async_done(ebtn_prepoll_async_t* prepoll);
+
+#if CONFIG_EBTN_PORT_MASK_64
+typedef uint64_t ebtn_mask_t;
+#else
+typedef uint32_t ebtn_mask_t;
+#endif
+
+#define EBTN_MASK_BITS (sizeof(ebtn_mask_t) * 8)
+
+/**
+ * @brief Port state callback prototype
+ *
+ * Returns the state of a whole group of pins in one call (e.g. a GPIO input register or an I2C port expander).
+ * State logic of each pin can be inverted using the active_low bool of the button attached to it.
+ *
+ * @param port The port number set in button_port_t
+ * @param ctx The user context set in button_port_t
+ * @return Current state of every pin in the port, bit n is pin n (1;active/pressed, 0;inactive)
+ */
+typedef ebtn_mask_t (*ebtn_poll_port_cb_t)(uint8_t port, void* ctx);
+
+typedef struct button_port button_port_t;
+
+typedef struct button_event button_event_t;
+
+typedef struct button_engine button_engine_t;
+
+/**
+ * @brief Event callback prototype
+ *
+ * Called directly from the polling context (the esp_timer task, or the polling task with CONFIG_EBTN_POLL_TASK) for every
+ * event of the button, instead of queueing it.
+ * Delays the rest of the poll, so it must return quickly and must never block: no queue sends with a timeout,
+ * no mutexes, no delays. Must not add or remove buttons (that waits for the poll to finish). The event is only
+ * valid during the call.
+ *
+ * @param event The event
+ */
+typedef void (*button_event_cb_t)(const button_event_t* event);
+
+#define BUTTON_EVENT_BIT(type) (1U << (type)) // event_mask bit of a button_event_type_t
+
+#if CONFIG_EBTN_COMPACT
+#define EBTN_TICK_MS CONFIG_EBTN_COMPACT_TICK_MS
+#define EBTN_TICKS_SATURATED UINT16_MAX // delta of a state that lasted 32768 ticks (0x8000) or more
+
+typedef uint16_t ebtn_time_t; // ticks of EBTN_TICK_MS
+#else
+typedef uint32_t ebtn_time_t; // milliseconds
+#endif
+
+#if CONFIG_EBTN_BTN_TIMING_PROFILES
+typedef struct {
+   uint16_t click_max_ms;      // maximum duration a button tap can be considered a consecutive click
+   uint16_t long_press_min_ms; // minimum time a button press needs to be considered a long press
+} button_timing_t;
+
+#define BUTTON_TIMING_DEFAULT {.click_max_ms = CONFIG_EBTN_CLICK_MAX_MS, .long_press_min_ms = CONFIG_EBTN_LONG_PRESS_MIN_MS}
+#endif
+
 typedef struct {
-   gpio_num_t pin;
-   ebtn_poll_state_cb_t poll_state_callback; // if NULL during init, uses builtin GPIO polling callback
+   gpio_num_t pin;                           // GPIO pin, or the bit index within the port word if port is set
+   ebtn_poll_state_cb_t poll_state_callback; // if NULL during init, uses builtin GPIO polling callback (ignored if port is set)
+   button_port_t* port;                      // if set, button state is read from the port instead of poll_state_callback
 
    uint8_t group;
+   uint8_t id; // application defined, with CONFIG_EBTN_SNAPSHOT ids 1 to 63 have their pressed state in snapshots and must be unique across engines
+               // required with CONFIG_EBTN_COMPACT: nonzero and unique per engine, compact events carry it instead of the sender
 
    bool internal_pull; // true to enable internal pullup/pulldowns (only if poll_state_callback was NULL during init)
    bool active_low;    // true if button is active low instead of active high
 
+   uint16_t debounce_ms; // time a state change must persist before it's accepted, 0 uses CONFIG_EBTN_BTN_DEBOUNCE_MS (ignored if port is set)
+
+   uint8_t event_mask;               // BUTTON_EVENT_BIT() of each event type to send, 0 sends all (other events are counted, but never queued)
+   button_event_cb_t event_callback; // if set, events are passed to this callback instead of the global callback or queue
+
+#if CONFIG_EBTN_BTN_TIMING_PROFILES
+   const button_timing_t* timing; // click and long press timing, NULL uses CONFIG_EBTN_CLICK_MAX_MS and CONFIG_EBTN_LONG_PRESS_MIN_MS
+#endif
+
    void* ctx;
 
    struct {
+#if CONFIG_EBTN_COMPACT
+      uint8_t state : 1;
+      uint8_t debouncing : 1; // raw state differs from state, since debounce_since
+      uint8_t long_press_pending : 1;
+#else
       uint8_t state;
-      uint32_t last_changed_ms;
-
-      uint8_t click_count;
+      bool debouncing; // raw state differs from state, since debounce_since
       bool long_press_pending;
-      uint32_t previous_delta_ms;
+#endif
+      uint8_t click_count;
+
+      ebtn_time_t last_changed;
+      ebtn_time_t debounce_since;
+      ebtn_time_t previous_delta;
+
+      uint16_t index; // position in the polling loop
+
+#if CONFIG_EBTN_STATS
+      uint32_t bounces;         // state changes rejected by debouncing (or by the port debounce), since added
+      uint32_t events_filtered; // events not sent because of event_mask, since added
+      uint32_t events_sent;     // since added
+      uint32_t events_dropped;  // since added
+#endif
    } internal;
 } button_t;
 
+struct button_port {
+   ebtn_poll_port_cb_t poll_port_callback; // required
+
+   uint8_t port;
+   void* ctx;
+
+   bool debounce; // true to only accept pin changes that are stable for 4 consecutive polls
+
+   // buttons, used, invert and reset are shared with button_add()/button_remove() and accessed atomically
+   struct {
+      button_t* buttons[EBTN_MASK_BITS];
+      ebtn_mask_t used;   // pins with a button attached
+      ebtn_mask_t invert; // pins of active low buttons
+      ebtn_mask_t reset;  // pins added since the last poll, whose state needs resetting
+      ebtn_mask_t state;  // debounced pin state (1;pressed)
+      ebtn_mask_t busy;   // pins that need processing even without a change (held, or clicks pending)
+      ebtn_mask_t cnt0;   // vertical debounce counter, bit 0
+      ebtn_mask_t cnt1;   // vertical debounce counter, bit 1
+      uint16_t index;     // position in the polling loop
+
+      button_engine_t* engine; // engine polling the port, set along with its first button and cleared with the last
+      uint8_t wakers;          // button_port_wake() calls in progress
+   } internal;
+};
+
 typedef enum {
    BUTTON_RELEASED = 0, // Released
    BUTTON_PRESSED,      // Pressed
@@ -51,20 +213,90 @@ typedef enum {
 
 } button_event_type_t;
 
-typedef struct {
+#if CONFIG_EBTN_COMPACT
+struct button_event {
+   uint8_t id;   // id of the button that sent this event
+   uint8_t type; // button_event_type_t
+   uint8_t count;
+
+   uint16_t delta_ticks;     // time since last state change in ticks, EBTN_TICKS_SATURATED if longer, zero if not available/applicable
+   uint16_t timestamp_ticks; // time of the poll that detected the event in ticks, wrapping (see ebtn_set_clock())
+};
+#else
+struct button_event {
    button_t* sender; // button that sent this event
    button_event_type_t type;
 
    uint8_t count;
    uint32_t delta_ms; // time since last state change in milliseconds (e.g. released -> pressed, or pressed -> released), zero if not available/applicable
-} button_event_t;
+
+   int64_t timestamp_us; // time of the poll that detected the event (see ebtn_set_clock())
+};
+#endif
+
+/**
+ * @brief Returns the id of the button that sent an event, in either event layout
+ */
+static inline uint8_t button_event_id(const button_event_t* event) {
+#if CONFIG_EBTN_COMPACT
+   return event->id;
+#else
+   return event->sender->id;
+#endif
+}
+
+/**
+ * @brief Returns the time since the last state change of an event in milliseconds, in either event layout
+ *
+ * With CONFIG_EBTN_COMPACT, in steps of EBTN_TICK_MS, and UINT32_MAX if the delta saturated.
+ */
+static inline uint32_t button_event_delta_ms(const button_event_t* event) {
+#if CONFIG_EBTN_COMPACT
+   return event->delta_ticks == EBTN_TICKS_SATURATED ? UINT32_MAX : (uint32_t)event->delta_ticks * EBTN_TICK_MS;
+#else
+   return event->delta_ms;
+#endif
+}
+
+#if CONFIG_EBTN_POLL_TASK
+/**
+ * Polling task of an engine (see CONFIG_EBTN_POLL_TASK)
+ */
+typedef struct {
+   UBaseType_t priority;
+   uint32_t stack_size;
+   int8_t core; // core to pin the task to, -1 for any core
+} ebtn_task_config_t;
+
+#define EBTN_TASK_CONFIG_DEFAULT {.priority = CONFIG_EBTN_POLL_TASK_PRIORITY, .stack_size = CONFIG_EBTN_POLL_TASK_STACK, .core = CONFIG_EBTN_POLL_TASK_CORE}
+#endif
+
+/**
+ * Configuration of a button engine created with button_engine_create()
+ */
+typedef struct {
+   QueueHandle_t queue;  // event queue, or NULL to use the engine's own event ring (only with CONFIG_EBTN_EVENT_RING)
+   uint32_t interval_us; // polling interval, 0 uses CONFIG_EBTN_POLLING_INTERVAL_MS_BTN
+   uint16_t max_buttons; // button capacity (initial capacity with CONFIG_EBTN_REGISTRY_DYNAMIC), 0 uses CONFIG_EBTN_MAX_COUNT_BTN
+   uint16_t max_ports;   // port capacity, 0 uses CONFIG_EBTN_MAX_COUNT_BTN_PORTS
+
+#if CONFIG_EBTN_POLL_TASK
+   const ebtn_task_config_t* task; // polling task, NULL uses EBTN_TASK_CONFIG_DEFAULT
+#endif
+} button_engine_config_t;
+
+typedef struct {
+   uint32_t period_us; // current polling period, zero while paused or stopped
+   uint64_t fast_us;   // total time spent polling at the fast period
+   uint64_t idle_us;   // total time spent polling at the idle period
+} ebtn_rate_info_t;
 
 /**
  * @brief Init library
  *
  * Creates and starts button polling timer and mutex.
  *
- * @param queue Event queue to send button events into
+ * @param queue Event queue to send button events into, or NULL to use the event ring (only with CONFIG_EBTN_EVENT_RING)
  * @return ESP_OK on success
  */
 esp_err_t button_init(QueueHandle_t queue);
@@ -94,35 +326,163 @@ esp_err_t button_start();
  */
 esp_err_t button_pause();
 
+#if CONFIG_EBTN_EVENT_RING
+/**
+ * @brief Copies pending button events out of the event ring
+ *
+ * Only valid if button_init() was called without a queue. Must only be called from a single consumer task.
+ *
+ * @param buf Buffer to copy events into
+ * @param n Maximum number of events to copy
+ * @return Number of events copied, 0 if none are pending
+ */
+size_t button_events_drain(button_event_t* buf, size_t n);
+
+/**
+ * @brief Sets the task notified when button events are available in the event ring
+ *
+ * The task receives at most one notification per poll (see ulTaskNotifyTake()), no matter how many events were added.
+ *
+ * @param task The consumer task, NULL to disable notifications
+ */
+void button_events_set_consumer(TaskHandle_t task);
+
+/**
+ * @brief Number of button events lost to event ring overflow since init
+ */
+uint32_t button_events_dropped();
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+/**
+ * @brief Gets the current button polling period and the time spent at each period
+ *
+ * @param info Output
+ */
+void button_get_rate_info(ebtn_rate_info_t* info);
+#endif
+
+/**
+ * @brief Resumes button polling after an idle shutdown
+ *
+ * Only has an effect with CONFIG_EBTN_BTN_IDLE_SHUTDOWN, where the polling timer is stopped while every button is idle.
+ * Buttons using the builtin GPIO polling callback wake the timer automatically from a GPIO edge interrupt. Buttons with a
+ * custom poll_state_callback can't, so call this when their state may have changed (e.g. from a port expander interrupt line).
+ * The first poll runs one polling interval later, a press released before then is not seen.
+ *
+ * Safe to call from ISR context.
+ */
+void button_wake();
+
+/**
+ * @brief Wakes the engine polling a port, if any
+ *
+ * Like button_wake(), for ports whose buttons may be added to any engine (e.g. a key matrix scanned by its own timer).
+ * Safe against the last button of the port being removed concurrently, and safe to call from ISR context.
+ */
+void button_port_wake(button_port_t* port);
+
+/**
+ * @brief Sets the event callback used for buttons without their own event_callback
+ *
+ * Events of those buttons are passed to the callback instead of the queue or event ring (see button_event_cb_t for the
+ * constraints). Buttons with their own event_callback keep using it, and the queue stays in use while the callback is NULL.
+ *
+ * @param event_callback The event callback, NULL to send events to the queue or event ring
+ */
+void button_set_event_callback(button_event_cb_t event_callback);
+
 /**
  * @brief Sets the pre-poll callback used for buttons
  *
  * Called just before polling all buttons. Useful for applications such as I2C port expanders.
+ * With CONFIG_EBTN_UNIFIED_TIMER, data shared with encoders is better read once per tick from ebtn_set_prepoll_callback().
  *
  * @param prepoll_callback The prepoll callback function, NULL to disable
  */
 void button_set_prepoll_callback(ebtn_prepoll_cb_t prepoll_callback);
 
+/**
+ * @brief Sets the pipelined pre-poll used for buttons, called after the pre-poll callback
+ *
+ * An async pre-poll must only be set on one engine (see ebtn_set_prepoll_async() to share one).
+ *
+ * @param prepoll The async pre-poll, NULL to disable
+ */
+void button_set_prepoll_async(ebtn_prepoll_async_t* prepoll);
+
 /**
  * @brief Init and add the specified button to the polling loop
  *
  * Button isn't copied. Ensure button_remove() is used before destruction/deallocation.
  *
+ * If the button has a port set, the port is added to the polling loop along with its first button, and removed with its last.
+ * Ports are read once per poll with a single call, and only buttons whose pin changed (or that are held/have clicks pending) are processed.
+ * Buttons attached to ports don't count towards CONFIG_EBTN_MAX_COUNT_BTN.
+ *
  * @param btn Pointer reference to the button
  *
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG with CONFIG_EBTN_COMPACT if the id is 0 or already used in the engine, or
+ *         with CONFIG_EBTN_SNAPSHOT if its snapshot slot is already used in any engine
  */
 esp_err_t button_add(button_t* btn);
 
 /**
  * @brief Removes button from the polling loop
  *
+ * Never blocks the polling timer. Waits for a poll that is already running to finish, so the button can be freed once this returns.
+ * Must not be called from the prepoll callback.
+ *
  * @param btn Pointer reference to the button
  *
  * @return ESP_OK on success
  */
 esp_err_t button_remove(button_t* btn);
 
+/**
+ * @brief Creates and starts a button engine
+ *
+ * Every button engine has its own polling timer, interval, queue, callbacks and buttons, so e.g. a panel can be polled
+ * slowly while other buttons are polled fast. The functions above work on the default engine, which is set up by
+ * button_init(). The button_engine_*() functions below take the engine as first argument, and otherwise work like
+ * their counterparts above. Created engines always have their own timer, even with CONFIG_EBTN_UNIFIED_TIMER.
+ *
+ * A button or port must only be added to one engine at a time. Poll statistics are summed over all engines.
+ *
+ * @param config Engine configuration, not kept
+ * @param out_engine Output, the new engine
+ * @return ESP_OK on success
+ */
+esp_err_t button_engine_create(const button_engine_config_t* config, button_engine_t** out_engine);
+
+/**
+ * @brief Stops and deletes a button engine created with button_engine_create()
+ *
+ * Its buttons are no longer polled, and can be freed once this returns.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t button_engine_delete(button_engine_t* engine);
+
+esp_err_t button_engine_start(button_engine_t* engine);
+esp_err_t button_engine_pause(button_engine_t* engine);
+esp_err_t button_engine_add(button_engine_t* engine, button_t* btn);
+esp_err_t button_engine_remove(button_engine_t* engine, button_t* btn);
+void button_engine_wake(button_engine_t* engine);
+void button_engine_set_event_callback(button_engine_t* engine, button_event_cb_t event_callback);
+void button_engine_set_prepoll_callback(button_engine_t* engine, ebtn_prepoll_cb_t prepoll_callback);
+void button_engine_set_prepoll_async(button_engine_t* engine, ebtn_prepoll_async_t* prepoll);
+
+#if CONFIG_EBTN_EVENT_RING
+size_t button_engine_events_drain(button_engine_t* engine, button_event_t* buf, size_t n);
+void button_engine_events_set_consumer(button_engine_t* engine, TaskHandle_t task);
+uint32_t button_engine_events_dropped(button_engine_t* engine);
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+void button_engine_get_rate_info(button_engine_t* engine, ebtn_rate_info_t* info);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,67 @@
+#ifndef _EBTN_BUTTON_LADDER_H
+#define _EBTN_BUTTON_LADDER_H
+
+#include <esp_err.h>
+
+#include "button.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct button_ladder button_ladder_t;
+
+/**
+ * @brief Ladder sample callback prototype
+ *
+ * Takes one reading of the ladder voltage (e.g. an ADC oneshot conversion, or a recorded trace in a test).
+ *
+ * @param ladder The ladder being sampled
+ * @return The reading, in the same units as the levels of the ladder (e.g. mV or raw ADC counts)
+ */
+typedef uint16_t (*button_ladder_sample_cb_t)(button_ladder_t* ladder);
+
+/**
+ * Resistor ladder, several buttons on a single analog input.
+ *
+ * Each poll takes one sample and classifies it as the button with the nearest level, or as released. The classification only
+ * changes once the sample is past the midpoint between two levels by more than the hysteresis, so noise around a midpoint
+ * doesn't toggle buttons. The pressed button is exposed as a one-hot button port, buttons are attached with
+ * .port = &ladder.port and .pin = their index in levels, and get the usual press/click/long press processing.
+ * Only one button is reported at a time, the ladder can't tell combinations apart.
+ */
+struct button_ladder {
+   uint8_t count;          // number of buttons, at most EBTN_MASK_BITS
+   const uint16_t* levels; // nominal reading while each button is pressed, by button index
+   uint16_t idle_level;    // nominal reading while no button is pressed
+   uint16_t hysteresis;    // distance past the midpoint between two levels a sample must reach to change the classification
+
+   button_ladder_sample_cb_t sample_callback; // required
+
+   void* ctx;
+
+   button_port_t port; // set up by button_ladder_init(), debounce can be set beforehand
+
+   struct {
+      uint8_t pressed; // index of the pressed button, count if released
+      uint16_t sample; // last sample
+   } internal;
+};
+
+/**
+ * @brief Inits the ladder port
+ *
+ * Must be called before any button of the ladder is added. Ladder isn't copied.
+ * The ladder is sampled from the button poll, so with CONFIG_EBTN_BTN_IDLE_SHUTDOWN call button_wake() (or button_engine_wake()) when a press is
+ * expected (e.g. from a comparator interrupt), otherwise presses are missed while idle.
+ *
+ * @param ladder Pointer reference to the ladder
+ * @return ESP_OK on success
+ */
+esp_err_t button_ladder_init(button_ladder_t* ladder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
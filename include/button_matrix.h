@@ -0,0 +1,107 @@
+#ifndef _EBTN_BUTTON_MATRIX_H
+#define _EBTN_BUTTON_MATRIX_H
+
+#include <esp_err.h>
+#include <driver/gpio.h>
+
+#include "button.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct button_matrix button_matrix_t;
+
+/**
+ * @brief Row select callback prototype
+ *
+ * Selects (drives active) or deselects a row. Deselected rows should be left floating or weakly pulled, so keys pressed in
+ * the same column of two rows don't short a selected row to a deselected one.
+ *
+ * @param matrix The matrix being scanned
+ * @param row The row index
+ * @param selected true to select the row, false to deselect it
+ */
+typedef void (*button_matrix_select_cb_t)(button_matrix_t* matrix, uint8_t row, bool selected);
+
+/**
+ * @brief Column read callback prototype
+ *
+ * Reads every column in one call (e.g. a GPIO input register or a port expander), while a single row is selected.
+ *
+ * @param matrix The matrix being scanned
+ * @return Column state, bit n is column n (1;key in the selected row pressed, 0;released). Already corrected for active_low.
+ */
+typedef uint32_t (*button_matrix_read_cb_t)(button_matrix_t* matrix);
+
+/**
+ * Key matrix, scanned one row at a time with a single column read per row.
+ *
+ * The scanned keys are exposed as a button port, so buttons are attached with .port = &matrix.port and
+ * .pin = button_matrix_key(&matrix, row, col), and get the usual press/click/long press processing.
+ * Only keys that changed (or are held/have clicks pending) are processed by the button poll.
+ * The scan is already corrected for active_low, so buttons of the matrix must leave their own active_low false.
+ */
+struct button_matrix {
+   uint8_t rows; // rows * cols must not exceed EBTN_MASK_BITS
+   uint8_t cols; // at most 32
+
+   const gpio_num_t* row_pins; // row GPIO pins, used if select_callback is NULL
+   const gpio_num_t* col_pins; // column GPIO pins, used if read_callback is NULL
+
+   button_matrix_select_cb_t select_callback; // if NULL during init, drives row_pins (open drain if active_low)
+   button_matrix_read_cb_t read_callback;     // if NULL during init, reads col_pins one by one
+
+   bool internal_pull; // true to enable internal pullup/pulldowns on col_pins (only if read_callback was NULL during init)
+   bool active_low;    // true if rows are selected low and pressed keys read low (only for the builtin callbacks)
+   bool diodes;        // true if every key has a diode, false to block keys whose state is ambiguous because of ghosting
+
+   uint32_t scan_interval_us; // period of the matrix scan timer, 0 to scan from the button poll instead (not with CONFIG_EBTN_BTN_IDLE_SHUTDOWN)
+   uint16_t settle_us;        // delay between selecting a row and reading the columns
+
+   void* ctx;
+
+   button_port_t port; // set up by button_matrix_init(), debounce can be set beforehand
+
+   struct {
+      ebtn_mask_t state;            // last scan, bit row * cols + col (1;pressed), shared with the button poll and accessed atomically
+      struct ebtn_hal_timer* timer; // scan timer, NULL when scanning from the button poll
+      uint32_t ghosts;              // scans where rows were blocked because of ghosting
+   } internal;
+};
+
+/**
+ * @brief Returns the port pin of a key, for button_t#pin
+ */
+static inline gpio_num_t button_matrix_key(const button_matrix_t* matrix, uint8_t row, uint8_t col) {
+   return (gpio_num_t)(row * matrix->cols + col);
+}
+
+/**
+ * @brief Inits the matrix pins and port, and starts the scan timer if scan_interval_us is set
+ *
+ * Must be called before any button of the matrix is added. Matrix isn't copied.
+ *
+ * Without diodes, two rows sharing two or more pressed columns can't be told apart from a real combination of keys (ghosting),
+ * so those rows keep their previous state until the ambiguity clears.
+ *
+ * @param matrix Pointer reference to the matrix
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if scan_interval_us is 0 with CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+ */
+esp_err_t button_matrix_init(button_matrix_t* matrix);
+
+/**
+ * @brief Stops and deletes the scan timer
+ *
+ * Every button of the matrix must be removed first.
+ *
+ * @param matrix Pointer reference to the matrix
+ * @return ESP_OK on success
+ */
+esp_err_t button_matrix_free(button_matrix_t* matrix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,12 +1,110 @@
 #ifndef _EBTN_H
 #define _EBTN_H
 
+#include <sdkconfig.h>
 #include <esp_err.h>
+#include <stdint.h>
+
+#include "button.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Clock callback prototype
+ *
+ * @return Monotonic time in microseconds
+ */
+typedef int64_t (*ebtn_clock_cb_t)();
+
+/**
+ * @brief Sets the clock used for button timing and event timestamps
+ *
+ * Defaults to esp_timer_get_time(). Mainly useful to drive the library from a simulated clock in tests.
+ * Must be set before any init, and must be safe to call from ISR context.
+ *
+ * @param clock The clock callback, NULL to restore the default
+ */
+void ebtn_set_clock(ebtn_clock_cb_t clock);
+
+#if CONFIG_EBTN_UNIFIED_TIMER
+/**
+ * @brief Sets the pre-poll callback of the shared polling timer
+ *
+ * Called once per tick, before polling encoders and (every Nth tick) buttons. Engine prepoll callbacks still run just
+ * before polling their own devices.
+ *
+ * @param prepoll_callback The prepoll callback function, NULL to disable
+ */
+void ebtn_set_prepoll_callback(ebtn_prepoll_cb_t prepoll_callback);
+
+/**
+ * @brief Sets the pipelined pre-poll of the shared polling timer, called once per tick after the pre-poll callback
+ *
+ * @param prepoll The async pre-poll, NULL to disable
+ */
+void ebtn_set_prepoll_async(ebtn_prepoll_async_t* prepoll);
+#endif
+
+#if CONFIG_EBTN_STATS
+#define EBTN_STATS_HIST_BUCKETS 16
+#define EBTN_STATS_EVENT_TYPES 4
+
+typedef struct {
+   uint32_t polls;
+   uint32_t late; // polls dispatched a full period or more behind schedule (catch-up polls included)
+
+   uint32_t time_min_us;                        // poll execution time, including the prepoll callback
+   uint32_t time_max_us;                        //
+   uint64_t time_total_us;                      // divide by polls for the average
+   uint32_t time_hist[EBTN_STATS_HIST_BUCKETS]; // polls by execution time, bucket 0;0us, n;[2^(n-1), 2^n)us, last bucket includes longer
+
+   uint32_t jitter_samples;  // polls with a known schedule (not the first after a start, rate change or idle shutdown)
+   int32_t jitter_min_us;    // dispatch time minus scheduled time
+   int32_t jitter_max_us;    //
+   int64_t jitter_total_us;  // divide by jitter_samples for the average
+
+   uint32_t events_sent[EBTN_STATS_EVENT_TYPES];     // by button_event_type_t, or 0;clockwise 1;counterclockwise for encoders
+   uint32_t events_dropped[EBTN_STATS_EVENT_TYPES];  // queue or event ring was full (see *_events_dropped() for evictions)
+   uint32_t events_filtered[EBTN_STATS_EVENT_TYPES]; // not sent because of button_t#event_mask, always 0 for encoders
+} ebtn_poll_stats_t;
+
+typedef struct {
+   ebtn_poll_stats_t buttons;
+   ebtn_poll_stats_t encoders;
+} ebtn_stats_t;
+
+/**
+ * @brief Copies a consistent snapshot of the poll statistics
+ *
+ * Per device totals are kept in the internal struct of each button and encoder (since it was added).
+ */
+void ebtn_get_stats(ebtn_stats_t* stats);
+
+/**
+ * @brief Resets the poll statistics
+ */
+void ebtn_reset_stats();
+#endif
+
+#if CONFIG_EBTN_SNAPSHOT
+typedef struct {
+   uint64_t pressed;                                     // bit n is set while the button with id n is pressed (debounced)
+   int32_t positions[CONFIG_EBTN_SNAPSHOT_ENCODERS + 1]; // position of the encoder with id n, index 0 is unused
+} ebtn_snapshot_t;
+
+/**
+ * @brief Copies a consistent snapshot of button and encoder state
+ *
+ * Lock-free, never blocks polling. Retries while the snapshot is being updated, so it never returns a partial update.
+ * Safe to call from any task or core. State changes are published by the poll that detects them.
+ *
+ * @param snapshot Output
+ */
+void ebtn_get_snapshot(ebtn_snapshot_t* snapshot);
+#endif
+
 static inline void ebtn_pause() {
    extern esp_err_t button_pause();
    extern esp_err_t rotary_encoder_pause();
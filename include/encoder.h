@@ -12,41 +12,181 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Encoder port state callback prototype
+ *
+ * Returns the A and B channel states of a whole group of encoders in one call (e.g. read from I2C port expanders).
+ * State logic of each encoder can be inverted using the active_low bool of the encoder.
+ *
+ * @param port The port number set in rotary_encoder_port_t
+ * @param ctx The user context set in rotary_encoder_port_t
+ * @param a Output, A channel state of every encoder in the port, bit n is encoder n (1;active, 0;inactive)
+ * @param b Output, B channel state of every encoder in the port, bit n is encoder n (1;active, 0;inactive)
+ */
+typedef void (*ebtn_poll_encoder_port_cb_t)(uint8_t port, void* ctx, ebtn_mask_t* a, ebtn_mask_t* b);
+
+typedef struct rotary_encoder_port rotary_encoder_port_t;
+
+typedef struct rotary_encoder_event rotary_encoder_event_t;
+
+typedef struct rotary_encoder_engine rotary_encoder_engine_t;
+
+/**
+ * @brief Event callback prototype
+ *
+ * Called directly from the polling context (the esp_timer task, or the polling task with CONFIG_EBTN_POLL_TASK) for every
+ * event of the encoder, instead of queueing it.
+ * Same constraints as button_event_cb_t: return quickly, never block, don't add or remove encoders. The event is only
+ * valid during the call.
+ *
+ * @param event The event
+ */
+typedef void (*rotary_encoder_event_cb_t)(const rotary_encoder_event_t* event);
+
+typedef enum {
+   ROT_STEP_FULL = 0, // one event per full quadrature cycle, at 11 after leaving 00 (default)
+   ROT_STEP_HALF,     // one event per half cycle, at 11 after leaving 00 and at 00 after leaving 11
+   ROT_STEP_QUARTER,  // one event per valid transition
+} rotary_encoder_step_mode_t;
+
 typedef struct {
    button_t* btn; // not currently used, set NULL if no button
-   gpio_num_t pin_a;
-   gpio_num_t pin_b;
+   gpio_num_t pin_a; // GPIO pin, or the bit index within the port A/B masks if port is set
+   gpio_num_t pin_b; // GPIO pin, unused if port is set
 
-   ebtn_poll_state_cb_t poll_state_callback; // if NULL during init, uses builtin GPIO polling callback
+   ebtn_poll_state_cb_t poll_state_callback; // if NULL during init, uses builtin GPIO polling callback (ignored if port is set)
+   rotary_encoder_port_t* port;              // if set, encoder state is read from the port instead of poll_state_callback
 
    bool internal_pull; // true to enable internal pullup/pulldowns (only if poll_state_callback was NULL during init)
    bool active_low;    // true if encoder pins are active low instead of active high
 
+   rotary_encoder_step_mode_t step_mode; // transitions per event, match the detents of the encoder
+
+   uint8_t id; // application defined, with CONFIG_EBTN_SNAPSHOT ids 1 to CONFIG_EBTN_SNAPSHOT_ENCODERS have their position in snapshots and must be unique across engines
+               // required with CONFIG_EBTN_COMPACT: nonzero and unique per engine, compact events carry it instead of the sender
+
+#if CONFIG_EBTN_SNAPSHOT
+   int32_t position_min; // position range, unlimited if min == max
+   int32_t position_max; //
+   bool position_wrap;   // true to wrap around from max to min and back, false to clamp to the range
+#endif
+
+   rotary_encoder_event_cb_t event_callback; // if set, events are passed to this callback instead of the global callback or queue
+
    void* ctx;
 
    struct {
-      uint8_t code;
-      uint16_t store;
+      uint8_t state; // decoder state, armed direction * 4 + last A/B sample
+
+#if CONFIG_EBTN_ENC_ISR
+      int16_t isr_steps;               // steps decoded from interrupts not yet sent, handed to the polling timer atomically
+      uint32_t last_edge_us;           // time of the last accepted edge, for the glitch filter
+      bool resample;                   // an edge was ignored by the glitch filter, the next poll samples the pins again
+      rotary_encoder_engine_t* engine; // engine woken by decoded steps
+#endif
+
+#if CONFIG_EBTN_ENC_COALESCE
+      int16_t steps;         // steps not yet sent
+      int64_t last_event_us; // time of the last sent event
+#endif
+
+      uint16_t index; // position in the polling loop
+
+#if CONFIG_EBTN_SNAPSHOT
+      int32_t position; // net steps since added, limited to the position range
+#endif
+
+#if CONFIG_EBTN_STATS
+      uint32_t events_sent;    // since added
+      uint32_t events_dropped; // since added
+#endif
    } internal;
 
 } rotary_encoder_t;
 
+struct rotary_encoder_port {
+   ebtn_poll_encoder_port_cb_t poll_port_callback; // required
+
+   uint8_t port;
+   void* ctx;
+
+   // encoders, used, invert, half, quarter and reset are shared with rotary_encoder_add()/rotary_encoder_remove() and accessed atomically
+   struct {
+      rotary_encoder_t* encoders[EBTN_MASK_BITS];
+      ebtn_mask_t used;    // bits with an encoder attached
+      ebtn_mask_t invert;  // bits of active low encoders
+      ebtn_mask_t reset;   // bits added since the last poll, whose state needs resetting
+      ebtn_mask_t a;       // previous A channel sample
+      ebtn_mask_t b;       // previous B channel sample
+      ebtn_mask_t half;    // bits of half step encoders, shared like invert
+      ebtn_mask_t quarter; // bits of quarter step encoders, shared like invert
+      ebtn_mask_t arm_cw;  // last valid transition was 00 -> 01 (or 11 -> 10 for half step)
+      ebtn_mask_t arm_ccw; // last valid transition was 00 -> 10 (or 11 -> 01 for half step)
+#if CONFIG_EBTN_ENC_COALESCE
+      ebtn_mask_t pending; // encoders with steps not yet sent
+#endif
+      uint16_t index; // position in the polling loop
+
+      rotary_encoder_engine_t* engine; // engine polling the port, set along with its first encoder
+   } internal;
+};
+
 typedef enum {
    ROT_CLOCKWISE = 1,
    ROT_COUNTERCLOCKWISE = -1,
 } rotary_encoder_rotation_t;
 
-typedef struct {
+struct rotary_encoder_event {
+#if CONFIG_EBTN_COMPACT
+   uint8_t id;               // id of the rotary encoder that sent this event
+   int8_t dir;               // rotary_encoder_rotation_t, sign of delta when coalescing
+   uint16_t timestamp_ticks; // time of the poll that detected the event in ticks of EBTN_TICK_MS, wrapping (see ebtn_set_clock())
+#else
    rotary_encoder_t* sender;      // rotary encoder that sent this event
-   rotary_encoder_rotation_t dir; // direction of rotation (-1;counterclockwise, 1;clockwise)
-} rotary_encoder_event_t;
+   rotary_encoder_rotation_t dir; // direction of rotation (-1;counterclockwise, 1;clockwise), sign of delta when coalescing
+   int64_t timestamp_us;          // time of the poll that detected the event (see ebtn_set_clock())
+#endif
+
+#if CONFIG_EBTN_ENC_COALESCE
+   int16_t delta;     // net steps since the previous event of this encoder
+   uint16_t velocity; // steps per second since the previous event of this encoder
+#if CONFIG_EBTN_ENC_ACCEL
+   int16_t accel_delta; // delta scaled by the acceleration curve
+#endif
+#endif
+};
+
+/**
+ * @brief Returns the id of the rotary encoder that sent an event, in either event layout
+ */
+static inline uint8_t rotary_encoder_event_id(const rotary_encoder_event_t* event) {
+#if CONFIG_EBTN_COMPACT
+   return event->id;
+#else
+   return event->sender->id;
+#endif
+}
+
+/**
+ * Configuration of an encoder engine created with rotary_encoder_engine_create()
+ */
+typedef struct {
+   QueueHandle_t queue;   // event queue, or NULL to use the engine's own event ring (only with CONFIG_EBTN_EVENT_RING)
+   uint32_t interval_us;  // polling interval, 0 uses CONFIG_EBTN_POLLING_INTERVAL_US_ENC
+   uint16_t max_encoders; // encoder capacity (initial capacity with CONFIG_EBTN_REGISTRY_DYNAMIC), 0 uses CONFIG_EBTN_MAX_COUNT_ENC
+   uint16_t max_ports;    // port capacity, 0 uses CONFIG_EBTN_MAX_COUNT_ENC_PORTS
+
+#if CONFIG_EBTN_POLL_TASK
+   const ebtn_task_config_t* task; // polling task, NULL uses EBTN_TASK_CONFIG_DEFAULT
+#endif
+} rotary_encoder_engine_config_t;
 
 /**
  * @brief Init library
  *
  * Creates and starts encoder polling timer and mutex.
  *
- * @param queue Event queue to send encoder events into
+ * @param queue Event queue to send encoder events into, or NULL to use the event ring (only with CONFIG_EBTN_EVENT_RING)
  * @return ESP_OK on success
  */
 esp_err_t rotary_encoder_init(QueueHandle_t queue);
@@ -76,35 +216,142 @@ esp_err_t rotary_encoder_start();
  */
 esp_err_t rotary_encoder_pause();
 
+#if CONFIG_EBTN_EVENT_RING
+/**
+ * @brief Copies pending encoder events out of the event ring
+ *
+ * Only valid if rotary_encoder_init() was called without a queue. Must only be called from a single consumer task.
+ *
+ * @param buf Buffer to copy events into
+ * @param n Maximum number of events to copy
+ * @return Number of events copied, 0 if none are pending
+ */
+size_t rotary_encoder_events_drain(rotary_encoder_event_t* buf, size_t n);
+
+/**
+ * @brief Sets the task notified when encoder events are available in the event ring
+ *
+ * The task receives at most one notification per poll (see ulTaskNotifyTake()), no matter how many events were added.
+ *
+ * @param task The consumer task, NULL to disable notifications
+ */
+void rotary_encoder_events_set_consumer(TaskHandle_t task);
+
+/**
+ * @brief Number of encoder events lost to event ring overflow since init
+ */
+uint32_t rotary_encoder_events_dropped();
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+/**
+ * @brief Gets the current encoder polling period and the time spent at each period
+ *
+ * @param info Output
+ */
+void rotary_encoder_get_rate_info(ebtn_rate_info_t* info);
+#endif
+
+/**
+ * @brief Sets the event callback used for encoders without their own event_callback
+ *
+ * Events of those encoders are passed to the callback instead of the queue or event ring (see rotary_encoder_event_cb_t
+ * for the constraints). Encoders with their own event_callback keep using it, and the queue stays in use while the
+ * callback is NULL.
+ *
+ * @param event_callback The event callback, NULL to send events to the queue or event ring
+ */
+void rotary_encoder_set_event_callback(rotary_encoder_event_cb_t event_callback);
+
 /**
  * @brief Sets the pre-poll callback used for rotary encoders
  *
  * Called just before polling all rotary encoders. Useful for applications such as I2C port expanders.
+ * With CONFIG_EBTN_UNIFIED_TIMER, data shared with buttons is better read once per tick from ebtn_set_prepoll_callback().
  *
  * @param prepoll_callback The prepoll callback function, NULL to disable
  */
 void rotary_encoder_set_prepoll_callback(ebtn_prepoll_cb_t prepoll_callback);
 
+/**
+ * @brief Sets the pipelined pre-poll used for rotary encoders, called after the pre-poll callback
+ *
+ * An async pre-poll must only be set on one engine (see ebtn_set_prepoll_async() to share one).
+ *
+ * @param prepoll The async pre-poll, NULL to disable
+ */
+void rotary_encoder_set_prepoll_async(ebtn_prepoll_async_t* prepoll);
+
 /**
  * @brief Init and add the specified encoder to the polling loop
  *
  * Encoder isn't copied. Ensure rotary_encoder_remove() is used before destruction/deallocation.
  *
+ * If the encoder has a port set, the port is added to the polling loop along with its first encoder, and removed with its last.
+ * All encoders of a port are decoded together using word-wide bit operations, so the cost of a poll barely depends on the number of encoders.
+ * Encoders attached to ports don't count towards CONFIG_EBTN_MAX_COUNT_ENC.
+ *
+ * With CONFIG_EBTN_ENC_ISR, encoders using the builtin GPIO polling callback are decoded from edge interrupts on both pins.
+ *
  * @param btn Pointer reference to the encoder
  *
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG with CONFIG_EBTN_COMPACT if the id is 0 or already used in the engine, or
+ *         with CONFIG_EBTN_SNAPSHOT if its snapshot slot is already used in any engine
  */
 esp_err_t rotary_encoder_add(rotary_encoder_t* enc);
 
 /**
  * @brief Removes encoder from the polling loop
  *
+ * Never blocks the polling timer. Waits for a poll that is already running to finish, so the encoder can be freed once this returns.
+ * Must not be called from the prepoll callback.
+ *
  * @param btn Pointer reference to the encoder
  *
  * @return ESP_OK on success
  */
 esp_err_t rotary_encoder_remove(rotary_encoder_t* enc);
 
+/**
+ * @brief Creates and starts an encoder engine
+ *
+ * Encoder engines work like button engines (see button_engine_create()): each has its own polling timer, interval, queue,
+ * callbacks and encoders, the functions above work on the default engine set up by rotary_encoder_init(), and the
+ * rotary_encoder_engine_*() functions below take the engine as first argument.
+ *
+ * @param config Engine configuration, not kept
+ * @param out_engine Output, the new engine
+ * @return ESP_OK on success
+ */
+esp_err_t rotary_encoder_engine_create(const rotary_encoder_engine_config_t* config, rotary_encoder_engine_t** out_engine);
+
+/**
+ * @brief Stops and deletes an encoder engine created with rotary_encoder_engine_create()
+ *
+ * Its encoders are no longer polled, and can be freed once this returns.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t rotary_encoder_engine_delete(rotary_encoder_engine_t* engine);
+
+esp_err_t rotary_encoder_engine_start(rotary_encoder_engine_t* engine);
+esp_err_t rotary_encoder_engine_pause(rotary_encoder_engine_t* engine);
+esp_err_t rotary_encoder_engine_add(rotary_encoder_engine_t* engine, rotary_encoder_t* enc);
+esp_err_t rotary_encoder_engine_remove(rotary_encoder_engine_t* engine, rotary_encoder_t* enc);
+void rotary_encoder_engine_set_event_callback(rotary_encoder_engine_t* engine, rotary_encoder_event_cb_t event_callback);
+void rotary_encoder_engine_set_prepoll_callback(rotary_encoder_engine_t* engine, ebtn_prepoll_cb_t prepoll_callback);
+void rotary_encoder_engine_set_prepoll_async(rotary_encoder_engine_t* engine, ebtn_prepoll_async_t* prepoll);
+
+#if CONFIG_EBTN_EVENT_RING
+size_t rotary_encoder_engine_events_drain(rotary_encoder_engine_t* engine, rotary_encoder_event_t* buf, size_t n);
+void rotary_encoder_engine_events_set_consumer(rotary_encoder_engine_t* engine, TaskHandle_t task);
+uint32_t rotary_encoder_engine_events_dropped(rotary_encoder_engine_t* engine);
+#endif
+
+#if CONFIG_EBTN_ADAPTIVE_POLLING
+void rotary_encoder_engine_get_rate_info(rotary_encoder_engine_t* engine, ebtn_rate_info_t* info);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
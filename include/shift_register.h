@@ -0,0 +1,91 @@
+#ifndef _EBTN_SHIFT_REGISTER_H
+#define _EBTN_SHIFT_REGISTER_H
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <driver/gpio.h>
+
+#include "button.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct shift_register shift_register_t;
+
+/**
+ * @brief Chain transfer callback prototype
+ *
+ * Latches the parallel inputs of every register in the chain, then clocks the whole chain into buf MSB first (e.g. a single
+ * SPI receive). The first byte is the register nearest the data pin.
+ *
+ * @param sr The shift register chain
+ * @param buf Output, len bytes
+ * @param len Length of the chain in bytes
+ * @return ESP_OK on success, buf is left unchanged on failure
+ */
+typedef esp_err_t (*shift_register_transfer_cb_t)(shift_register_t* sr, uint8_t* buf, size_t len);
+
+/**
+ * Parallel-in/serial-out shift register chain (e.g. 74HC165), read into one buffer per poll.
+ *
+ * Input n is bit n % 8 of byte n / 8, so with MSB first transfers input 0 is D0/A of the register nearest the data pin.
+ * Buttons and encoders are attached through ports using shift_register_poll_button_port() and
+ * shift_register_poll_encoder_port(), which map the buffer onto port masks without per-pin callbacks.
+ */
+struct shift_register {
+   uint16_t inputs; // length of the chain, a multiple of 8
+   uint8_t* buf;    // inputs / 8 bytes, holds the last transfer
+
+   shift_register_transfer_cb_t transfer_callback; // if NULL during init, uses builtin bit-banging of the pins below
+
+   gpio_num_t load_pin;  // parallel load, pulsed low to latch the inputs (SH/LD)
+   gpio_num_t clock_pin; // shift clock, rising edge (CLK)
+   gpio_num_t data_pin;  // serial output of the register nearest the MCU (QH)
+
+   void* ctx;
+};
+
+/**
+ * @brief Inits the chain, and its pins when using the builtin transfer
+ *
+ * Shift register isn't copied.
+ *
+ * @param sr Pointer reference to the shift register chain
+ * @return ESP_OK on success
+ */
+esp_err_t shift_register_init(shift_register_t* sr);
+
+/**
+ * @brief Reads the whole chain into buf
+ *
+ * Call once per poll from the prepoll callback, before the ports are read (or from ebtn_set_prepoll_callback() to share a
+ * chain between buttons and encoders with CONFIG_EBTN_UNIFIED_TIMER).
+ *
+ * @param sr Pointer reference to the shift register chain
+ * @return ESP_OK on success
+ */
+esp_err_t shift_register_update(shift_register_t* sr);
+
+/**
+ * @brief Button port callback reading the chain buffer
+ *
+ * Set as button_port_t#poll_port_callback with the chain as ctx. The port number is the first byte of the chain used by the
+ * port, so pin n of port p is input p * 8 + n. Inputs past the end of the chain read as 0.
+ */
+ebtn_mask_t shift_register_poll_button_port(uint8_t port, void* ctx);
+
+/**
+ * @brief Encoder port callback reading the chain buffer
+ *
+ * Set as rotary_encoder_port_t#poll_port_callback with the chain as ctx. The port number is the first byte of the chain used
+ * by the port, and A/B channels are interleaved, so encoder n of port p has A on input p * 8 + 2n and B on the next input.
+ * Inputs past the end of the chain read as 0.
+ */
+void shift_register_poll_encoder_port(uint8_t port, void* ctx, ebtn_mask_t* a, ebtn_mask_t* b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+#include "ebtn_prepoll.h"
+
+#include <esp_attr.h>
+
+void ebtn_prepoll_async_tick(ebtn_prepoll_async_t* prepoll) {
+   if (prepoll->internal.in_flight) {
+      if (!__atomic_exchange_n(&prepoll->internal.done, false, __ATOMIC_ACQUIRE)) {
+         prepoll->internal.overruns++; // bus still busy, decode the last completed read again
+         return;
+      }
+
+      // swapped only here, so every state callback of a poll sees the same read
+      prepoll->internal.front ^= 1;
+      prepoll->internal.in_flight = false;
+   }
+
+   prepoll->internal.in_flight = true;
+   prepoll->start(prepoll, prepoll->buf[prepoll->internal.front ^ 1]);
+}
+
+void IRAM_ATTR ebtn_prepoll_async_done(ebtn_prepoll_async_t* prepoll) {
+   __atomic_store_n(&prepoll->internal.done, true, __ATOMIC_RELEASE);
+}
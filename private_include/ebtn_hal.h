@@ -0,0 +1,137 @@
+#ifndef _EBTN_HAL_H
+#define _EBTN_HAL_H
+
+#include <esp_err.h>
+#include <driver/gpio.h>
+
+#include "button.h"
+
+/*
+ * Thin platform layer used by the button and encoder engines.
+ *
+ * Every GPIO, timer and clock access goes through these functions, so a replacement implementation linked instead of hal.c
+ * controls time, pin levels and timer dispatch. Interrupt driven encoders only see edges through ebtn_hal_gpio_isr_add(), so
+ * a replacement can replay A/B edges by calling the registered handler.
+ * The layer doesn't cover everything else: this header takes gpio_num_t from driver/gpio.h, and the engines use FreeRTOS
+ * queues, mutexes and critical sections, esp_check.h and esp_attr.h directly. A host build also needs stand-ins for those
+ * headers, test/host has both the stand-ins and a simulated implementation of this header.
+ */
+
+typedef struct ebtn_hal_timer* ebtn_hal_timer_t;
+
+typedef void (*ebtn_hal_cb_t)(void* arg);
+
+/**
+ * @brief Monotonic time in microseconds, from the clock set with ebtn_set_clock()
+ */
+int64_t ebtn_hal_time_us();
+
+#if CONFIG_EBTN_COMPACT
+#define EBTN_TICK_US (EBTN_TICK_MS * 1000)
+
+/**
+ * @brief Converts a time in microseconds to ticks of EBTN_TICK_MS, wrapping
+ */
+static inline uint32_t ebtn_hal_ticks(int64_t us) {
+   return (uint32_t)(us / EBTN_TICK_US);
+}
+#endif
+
+/**
+ * @brief Configures a pin as an input with optional internal pullup/pulldown
+ *
+ * @param pin The GPIO pin
+ * @param internal_pull true to enable the internal pull resistor
+ * @param active_low true for a pullup, false for a pulldown (only if internal_pull is true)
+ * @return ESP_OK on success
+ */
+esp_err_t ebtn_hal_gpio_input_init(gpio_num_t pin, bool internal_pull, bool active_low);
+
+/**
+ * @brief Reads the level of a GPIO pin (1;high, 0;low)
+ */
+uint8_t ebtn_hal_gpio_get_level(gpio_num_t pin);
+
+/**
+ * @brief Configures a pin as an output driven to the given level
+ *
+ * @param pin The GPIO pin
+ * @param open_drain true to only drive low, high leaves the pin floating
+ * @param level Initial level (1;high, 0;low)
+ * @return ESP_OK on success
+ */
+esp_err_t ebtn_hal_gpio_output_init(gpio_num_t pin, bool open_drain, uint8_t level);
+
+/**
+ * @brief Drives an output pin (1;high, 0;low)
+ */
+void ebtn_hal_gpio_set_level(gpio_num_t pin, uint8_t level);
+
+/**
+ * @brief Busy waits, for short settling times only
+ */
+void ebtn_hal_delay_us(uint32_t us);
+
+/**
+ * @brief Attaches an any-edge interrupt handler to a GPIO pin
+ *
+ * Installs the shared GPIO ISR service if needed. The handler runs in ISR context.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ebtn_hal_gpio_isr_add(gpio_num_t pin, ebtn_hal_cb_t handler, void* arg);
+
+/**
+ * @brief Detaches the interrupt handler from a GPIO pin
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ebtn_hal_gpio_isr_remove(gpio_num_t pin);
+
+/**
+ * @brief Creates a timer dispatched from the timer task
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t ebtn_hal_timer_create(const char* name, ebtn_hal_cb_t callback, void* arg, ebtn_hal_timer_t* out_timer);
+
+#if CONFIG_EBTN_POLL_TASK
+/**
+ * @brief Creates a timer dispatched from a dedicated task
+ *
+ * The task is woken by the timer and runs the callback, expirations that happen while the callback is still running are
+ * merged into a single call. Otherwise used like any other timer.
+ *
+ * @param task Priority, stack size and core of the task
+ * @return ESP_OK on success
+ */
+esp_err_t ebtn_hal_timer_create_task(const char* name, ebtn_hal_cb_t callback, void* arg, const ebtn_task_config_t* task, ebtn_hal_timer_t* out_timer);
+#endif
+
+/**
+ * @brief Stops and deletes a timer
+ */
+esp_err_t ebtn_hal_timer_delete(ebtn_hal_timer_t timer);
+
+/**
+ * @brief Starts a periodic timer, safe to call from ISR context
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already running
+ */
+esp_err_t ebtn_hal_timer_start_periodic(ebtn_hal_timer_t timer, uint64_t period_us);
+
+/**
+ * @brief Changes the period of a running periodic timer
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not running
+ */
+esp_err_t ebtn_hal_timer_restart(ebtn_hal_timer_t timer, uint64_t period_us);
+
+/**
+ * @brief Stops a timer, safe to call from ISR context
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not running
+ */
+esp_err_t ebtn_hal_timer_stop(ebtn_hal_timer_t timer);
+
+#endif // _EBTN_HAL_H
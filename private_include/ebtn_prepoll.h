@@ -0,0 +1,11 @@
+#ifndef _EBTN_PREPOLL_H
+#define _EBTN_PREPOLL_H
+
+#include "button.h"
+
+/**
+ * @brief Swaps in the last completed read and starts the next one, call from the polling context before decoding
+ */
+void ebtn_prepoll_async_tick(ebtn_prepoll_async_t* prepoll);
+
+#endif // _EBTN_PREPOLL_H
@@ -0,0 +1,104 @@
+#ifndef _EBTN_RATE_H
+#define _EBTN_RATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "button.h"
+
+/*
+ * Adaptive polling rate, shared by the button and encoder engines.
+ *
+ * Polls at the fast period while there is activity, and drops to the idle period after a quiet time without any.
+ * Only touched from the polling context, except for reads done while holding the engine mutex.
+ */
+
+typedef struct {
+   uint32_t fast_us;
+   uint32_t idle_us;
+   uint32_t quiet_us;
+
+   uint32_t period_us; // current period
+   bool running;       // false while paused or stopped
+
+   int64_t since_us;         // start of the current period
+   int64_t last_activity_us; // time of the last poll with activity
+
+   uint64_t fast_total_us;
+   uint64_t idle_total_us;
+} ebtn_rate_t;
+
+static inline void ebtn_rate_init(ebtn_rate_t* rate, uint32_t fast_us, uint32_t idle_us, uint32_t quiet_us) {
+   *rate = (ebtn_rate_t){.fast_us = fast_us, .idle_us = idle_us, .quiet_us = quiet_us, .period_us = fast_us};
+}
+
+static inline void ebtn_rate_account(ebtn_rate_t* rate, int64_t now_us) {
+   if (!rate->running)
+      return;
+
+   if (rate->period_us == rate->fast_us) {
+      rate->fast_total_us += now_us - rate->since_us;
+   } else {
+      rate->idle_total_us += now_us - rate->since_us;
+   }
+
+   rate->since_us = now_us;
+}
+
+/**
+ * @brief Marks polling as started at the fast period
+ */
+static inline void ebtn_rate_start(ebtn_rate_t* rate, int64_t now_us) {
+   ebtn_rate_account(rate, now_us);
+
+   rate->period_us = rate->fast_us;
+   rate->running = true;
+   rate->since_us = now_us;
+   rate->last_activity_us = now_us;
+}
+
+/**
+ * @brief Marks polling as stopped, time until the next start isn't accounted
+ */
+static inline void ebtn_rate_stop(ebtn_rate_t* rate, int64_t now_us) {
+   ebtn_rate_account(rate, now_us);
+   rate->running = false;
+}
+
+/**
+ * @brief Updates the rate after a poll
+ *
+ * @param active true if the poll detected any activity
+ * @return The new period if it changed, zero otherwise
+ */
+static inline uint32_t ebtn_rate_update(ebtn_rate_t* rate, int64_t now_us, bool active) {
+   if (!rate->running) // restarted without ebtn_rate_start() (e.g. woken from ISR), which is always at the fast period
+      ebtn_rate_start(rate, now_us);
+
+   if (active)
+      rate->last_activity_us = now_us;
+
+   const uint32_t period_us = (now_us - rate->last_activity_us < rate->quiet_us) ? rate->fast_us : rate->idle_us;
+   if (period_us == rate->period_us)
+      return 0;
+
+   ebtn_rate_account(rate, now_us);
+   rate->period_us = period_us;
+   return period_us;
+}
+
+static inline void ebtn_rate_get(const ebtn_rate_t* rate, int64_t now_us, ebtn_rate_info_t* info) {
+   info->period_us = rate->running ? rate->period_us : 0;
+   info->fast_us = rate->fast_total_us;
+   info->idle_us = rate->idle_total_us;
+
+   if (rate->running) {
+      if (rate->period_us == rate->fast_us) {
+         info->fast_us += now_us - rate->since_us;
+      } else {
+         info->idle_us += now_us - rate->since_us;
+      }
+   }
+}
+
+#endif // _EBTN_RATE_H
@@ -0,0 +1,132 @@
+#ifndef _EBTN_REGISTRY_H
+#define _EBTN_REGISTRY_H
+
+#include <esp_err.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+/*
+ * Dense device registry that can be read by the polling context without locking.
+ *
+ * Live devices are kept contiguous in [0, count), and every device stores its own position (index field at index_offset),
+ * so add, remove and lookup are O(1). Removal moves the last device into the freed position.
+ *
+ * The poll wraps every pass over its registries in ebtn_epoch_enter()/ebtn_epoch_exit() and reads with atomic loads.
+ * Writers (add/remove) are serialized by the caller, and after removing a device (or replacing the array when growing) wait
+ * for any poll that may still hold a pointer to it (ebtn_epoch_synchronize()), so it can be freed as soon as remove returns.
+ */
+
+typedef struct {
+   atomic_uint seq; // odd while a poll is running
+} ebtn_epoch_t;
+
+typedef struct {
+   _Atomic(_Atomic(void*)*) items; // live devices in [0, count)
+   _Atomic(uint16_t) count;
+   _Atomic(void*) moving; // device a remove is moving to a lower position, until no poll can see it at both
+   uint16_t capacity;
+   uint16_t index_offset; // offset of the uint16_t position field within a device
+   ebtn_epoch_t* epoch;
+} ebtn_registry_t;
+
+// registry array, static unless dynamic
+#if CONFIG_EBTN_REGISTRY_DYNAMIC
+#define EBTN_REGISTRY_STORAGE(name, capacity) static _Atomic(void*)* const name = NULL
+#else
+#define EBTN_REGISTRY_STORAGE(name, capacity) static _Atomic(void*) name[capacity]
+#endif
+
+static inline void ebtn_epoch_enter(ebtn_epoch_t* epoch) {
+   atomic_fetch_add(&epoch->seq, 1);
+}
+
+static inline void ebtn_epoch_exit(ebtn_epoch_t* epoch) {
+   atomic_fetch_add(&epoch->seq, 1);
+}
+
+/**
+ * @brief Waits until any poll running at the time of the call has finished
+ *
+ * Must not be called from the polling context.
+ */
+void ebtn_epoch_synchronize(ebtn_epoch_t* epoch);
+
+/**
+ * @brief Inits an empty registry
+ *
+ * @param storage Array of capacity slots. With CONFIG_EBTN_REGISTRY_DYNAMIC, NULL to allocate it, grown on demand.
+ * @param index_offset offsetof() the uint16_t field each device keeps its position in
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the array couldn't be allocated
+ */
+esp_err_t ebtn_registry_init(ebtn_registry_t* reg, _Atomic(void*)* storage, uint16_t capacity, size_t index_offset, ebtn_epoch_t* epoch);
+
+/**
+ * @brief Frees an allocated array, the registry must no longer be polled
+ */
+void ebtn_registry_deinit(ebtn_registry_t* reg);
+
+/**
+ * @brief Number of devices to poll, must be loaded before ebtn_registry_items()
+ */
+static inline uint16_t ebtn_registry_count(ebtn_registry_t* reg) {
+   return atomic_load_explicit(&reg->count, memory_order_acquire);
+}
+
+static inline _Atomic(void*)* ebtn_registry_items(ebtn_registry_t* reg) {
+   return atomic_load_explicit(&reg->items, memory_order_acquire);
+}
+
+static inline void* ebtn_registry_get(_Atomic(void*)* items, uint16_t index) {
+   return atomic_load_explicit(&items[index], memory_order_acquire);
+}
+
+/**
+ * @brief Loads the device at index for a poll pass, NULL if the pass already got it
+ *
+ * A concurrent remove moves the last device to a lower position, where a pass that loaded the count before may find it
+ * again. Polling a device twice in a pass isn't a no-op (port debounce counters advance on every poll), so poll loops use
+ * this instead of ebtn_registry_get().
+ *
+ * @param seen pass-local, NULL before the first call of each pass over the registry
+ */
+static inline void* ebtn_registry_next(ebtn_registry_t* reg, _Atomic(void*)* items, uint16_t index, void** seen) {
+   void* item = atomic_load_explicit(&items[index], memory_order_acquire);
+   if (item == *seen)
+      return NULL;
+
+   // the moving pointer is published before the device is stored at its new position
+   if (item == atomic_load_explicit(&reg->moving, memory_order_acquire))
+      *seen = item;
+   return item;
+}
+
+/**
+ * @brief Publishes an item, which must be fully initialized
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already added, ESP_ERR_NO_MEM if full
+ */
+esp_err_t ebtn_registry_add(ebtn_registry_t* reg, void* item);
+
+/**
+ * @brief Unpublishes an item and waits until no poll can still be using it
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if not found
+ */
+esp_err_t ebtn_registry_remove(ebtn_registry_t* reg, void* item);
+
+/**
+ * @brief Checks whether an item is published
+ */
+bool ebtn_registry_contains(ebtn_registry_t* reg, void* item);
+
+/**
+ * @brief Checks whether there is room for another item, always true for allocated arrays
+ */
+bool ebtn_registry_full(ebtn_registry_t* reg);
+
+#endif // _EBTN_REGISTRY_H
@@ -0,0 +1,72 @@
+#ifndef _EBTN_RING_H
+#define _EBTN_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Lock-free single-producer/single-consumer event ring.
+ *
+ * The producer (polling context) never blocks or retries. The consumer drains events in batches. When the ring is full,
+ * the event is handled according to CONFIG_EBTN_EVENT_RING_OVERFLOW_*.
+ */
+
+/**
+ * @brief Merges src into dst if possible (used by the coalesce overflow policy)
+ *
+ * @return true if src was folded into dst, false if the events are unrelated
+ */
+typedef bool (*ebtn_ring_merge_cb_t)(void* dst, const void* src);
+
+typedef struct {
+   uint8_t* buf;
+   size_t item_size;
+   uint32_t mask; // length - 1, length must be a power of two
+
+   ebtn_ring_merge_cb_t merge;
+
+   atomic_uint head; // next slot to write, only advanced by the producer
+   atomic_uint tail; // next slot to read, advanced by the consumer (and the producer when dropping the oldest event)
+   atomic_uint dropped;
+
+   // producer only, holds an overflowed event until there is room (coalesce policy)
+   bool overflow_pending;
+   bool overflow_sealed; // an event was discarded since, so merging into the held event would hide it
+   uint8_t* overflow;
+} ebtn_ring_t;
+
+/**
+ * @brief Inits a ring over caller provided storage
+ *
+ * @param buf Storage for length items
+ * @param overflow Storage for one item, used by the coalesce policy (can be NULL otherwise)
+ * @param length Number of items, must be a power of two
+ */
+void ebtn_ring_init(ebtn_ring_t* ring, void* buf, void* overflow, size_t item_size, uint32_t length, ebtn_ring_merge_cb_t merge);
+
+/**
+ * @brief Pushes an event (producer only, wait-free)
+ *
+ * @return true if the event was queued, held back or merged, false if an event was dropped
+ */
+bool ebtn_ring_push(ebtn_ring_t* ring, const void* item);
+
+/**
+ * @brief Publishes a coalesced overflow event if there is room again (producer only, wait-free)
+ *
+ * Call at the end of each poll cycle.
+ *
+ * @return true if the held event was published
+ */
+bool ebtn_ring_flush(ebtn_ring_t* ring);
+
+/**
+ * @brief Copies up to n events out of the ring (consumer only)
+ *
+ * @return Number of events copied
+ */
+size_t ebtn_ring_pop(ebtn_ring_t* ring, void* out, size_t n);
+
+#endif // _EBTN_RING_H
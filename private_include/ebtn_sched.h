@@ -0,0 +1,50 @@
+#ifndef _EBTN_SCHED_H
+#define _EBTN_SCHED_H
+
+#include <esp_err.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+/*
+ * Shared polling timer (CONFIG_EBTN_UNIFIED_TIMER).
+ *
+ * Ticks at the encoder polling interval, polling encoders every tick and buttons every EBTN_SCHED_BTN_TICKS ticks.
+ * The engines attach in their init, and start/stop their share of the ticks instead of running their own timers.
+ */
+
+#if CONFIG_EBTN_UNIFIED_TIMER
+#define EBTN_SCHED_BTN_RATIO ((CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000 + CONFIG_EBTN_POLLING_INTERVAL_US_ENC / 2) / CONFIG_EBTN_POLLING_INTERVAL_US_ENC)
+#define EBTN_SCHED_BTN_TICKS (EBTN_SCHED_BTN_RATIO > 0 ? EBTN_SCHED_BTN_RATIO : 1)
+
+typedef enum {
+   EBTN_SCHED_BUTTONS = 1 << 0,
+   EBTN_SCHED_ENCODERS = 1 << 1,
+} ebtn_sched_client_t;
+
+/**
+ * @brief Attaches an engine, creating the timer for the first one
+ */
+esp_err_t ebtn_sched_attach(ebtn_sched_client_t client);
+
+/**
+ * @brief Detaches a stopped engine, deleting the timer after the last one
+ */
+esp_err_t ebtn_sched_detach(ebtn_sched_client_t client);
+
+/**
+ * @brief Starts polling an engine, starting the timer if it was the only one stopped
+ */
+esp_err_t ebtn_sched_start(ebtn_sched_client_t client);
+
+/**
+ * @brief Stops polling an engine, stopping the timer if no other is running
+ */
+esp_err_t ebtn_sched_stop(ebtn_sched_client_t client);
+
+// called from the shared timer, defined by the engines
+void ebtn_sched_poll_buttons();
+void ebtn_sched_poll_encoders();
+#endif
+
+#endif // _EBTN_SCHED_H
@@ -0,0 +1,82 @@
+#ifndef _EBTN_SNAPSHOT_H
+#define _EBTN_SNAPSHOT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+
+#include "ebtn.h"
+
+/*
+ * Button and encoder state snapshot, published with a seqlock.
+ *
+ * Writers (the polling contexts) wrap every update in ebtn_snapshot_write_begin()/ebtn_snapshot_write_end(), which serializes
+ * them with a spinlock and makes the sequence odd while the snapshot is inconsistent. Readers never lock, they retry until
+ * they copied the snapshot with the same even sequence before and after.
+ */
+
+#if CONFIG_EBTN_SNAPSHOT
+extern ebtn_snapshot_t ebtn_snapshot;
+extern atomic_uint ebtn_snapshot_seq;
+extern portMUX_TYPE ebtn_snapshot_lock;
+
+static inline void ebtn_snapshot_write_begin() {
+   portENTER_CRITICAL(&ebtn_snapshot_lock);
+   atomic_store_explicit(&ebtn_snapshot_seq, atomic_load_explicit(&ebtn_snapshot_seq, memory_order_relaxed) + 1, memory_order_relaxed);
+   atomic_thread_fence(memory_order_release); // odd sequence is visible before any data changes
+}
+
+static inline void ebtn_snapshot_write_end() {
+   atomic_store_explicit(&ebtn_snapshot_seq, atomic_load_explicit(&ebtn_snapshot_seq, memory_order_relaxed) + 1, memory_order_release);
+   portEXIT_CRITICAL(&ebtn_snapshot_lock);
+}
+
+/**
+ * @brief Claims the pressed bit of a button id for a button being added, in any engine
+ *
+ * Snapshots are shared by all engines, so ids with a slot must be unique across them (unlike compact ids). Ids without
+ * a slot always succeed.
+ *
+ * @return false if another button already has the id
+ */
+bool ebtn_snapshot_claim_pressed(uint8_t id);
+void ebtn_snapshot_release_pressed(uint8_t id);
+
+/**
+ * @brief Claims the position of an encoder id for an encoder being added, like ebtn_snapshot_claim_pressed()
+ */
+bool ebtn_snapshot_claim_position(uint8_t id);
+void ebtn_snapshot_release_position(uint8_t id);
+
+/**
+ * @brief Publishes the pressed state of a button, ids outside 1 to 63 are ignored
+ */
+static inline void ebtn_snapshot_set_pressed(uint8_t id, bool pressed) {
+   if (!id || id > 63)
+      return;
+
+   ebtn_snapshot_write_begin();
+   if (pressed) {
+      ebtn_snapshot.pressed |= 1ULL << id;
+   } else {
+      ebtn_snapshot.pressed &= ~(1ULL << id);
+   }
+   ebtn_snapshot_write_end();
+}
+
+/**
+ * @brief Publishes the position of an encoder, ids outside 1 to CONFIG_EBTN_SNAPSHOT_ENCODERS are ignored
+ */
+static inline void ebtn_snapshot_set_position(uint8_t id, int32_t position) {
+   if (!id || id > CONFIG_EBTN_SNAPSHOT_ENCODERS)
+      return;
+
+   ebtn_snapshot_write_begin();
+   ebtn_snapshot.positions[id] = position;
+   ebtn_snapshot_write_end();
+}
+#endif
+
+#endif // _EBTN_SNAPSHOT_H
@@ -0,0 +1,77 @@
+#ifndef _EBTN_STATS_H
+#define _EBTN_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+
+#include "ebtn.h"
+#include "ebtn_hal.h"
+
+/*
+ * Poll statistics, shared by the button and encoder engines.
+ *
+ * Updated from the polling contexts and read/reset from any task, always while holding ebtn_stats_lock.
+ */
+
+#if CONFIG_EBTN_STATS
+extern ebtn_stats_t ebtn_stats;
+extern portMUX_TYPE ebtn_stats_lock;
+
+/**
+ * @brief Records a finished poll, call last thing in the poll
+ *
+ * @param next_us Scheduled time of this poll, 0 if unknown. Updated to the scheduled time of the next poll.
+ * @param dispatch_us Time the poll started
+ * @param period_us Current polling period
+ */
+static inline void ebtn_stats_poll(ebtn_poll_stats_t* stats, int64_t* next_us, int64_t dispatch_us, uint32_t period_us) {
+   const uint32_t time_us = ebtn_hal_time_us() - dispatch_us;
+   const uint8_t bucket = time_us ? 32 - __builtin_clz(time_us) : 0;
+   const int64_t scheduled_us = *next_us;
+
+   portENTER_CRITICAL(&ebtn_stats_lock);
+   stats->polls++;
+   stats->time_total_us += time_us;
+   if (time_us < stats->time_min_us)
+      stats->time_min_us = time_us;
+   if (time_us > stats->time_max_us)
+      stats->time_max_us = time_us;
+   stats->time_hist[bucket < EBTN_STATS_HIST_BUCKETS ? bucket : EBTN_STATS_HIST_BUCKETS - 1]++;
+
+   if (scheduled_us) {
+      const int32_t jitter_us = dispatch_us - scheduled_us;
+      stats->jitter_samples++;
+      stats->jitter_total_us += jitter_us;
+      if (jitter_us < stats->jitter_min_us)
+         stats->jitter_min_us = jitter_us;
+      if (jitter_us > stats->jitter_max_us)
+         stats->jitter_max_us = jitter_us;
+      if (jitter_us >= (int32_t)period_us)
+         stats->late++;
+   }
+   portEXIT_CRITICAL(&ebtn_stats_lock);
+
+   // periodic timers keep their schedule when late, catching up on missed periods
+   *next_us = (scheduled_us ? scheduled_us : dispatch_us) + period_us;
+}
+
+static inline void ebtn_stats_event(ebtn_poll_stats_t* stats, uint8_t type, bool sent) {
+   portENTER_CRITICAL(&ebtn_stats_lock);
+   if (sent) {
+      stats->events_sent[type]++;
+   } else {
+      stats->events_dropped[type]++;
+   }
+   portEXIT_CRITICAL(&ebtn_stats_lock);
+}
+
+static inline void ebtn_stats_filtered(ebtn_poll_stats_t* stats, uint8_t type) {
+   portENTER_CRITICAL(&ebtn_stats_lock);
+   stats->events_filtered[type]++;
+   portEXIT_CRITICAL(&ebtn_stats_lock);
+}
+#endif
+
+#endif // _EBTN_STATS_H
@@ -0,0 +1,129 @@
+#include "ebtn_registry.h"
+
+#include <stdlib.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define INDEX(reg, item) ((uint16_t*)((uint8_t*)(item) + (reg)->index_offset))
+
+void ebtn_epoch_synchronize(ebtn_epoch_t* epoch) {
+   const unsigned seq = atomic_load(&epoch->seq);
+   if (!(seq & 1))
+      return;
+
+   while (atomic_load(&epoch->seq) == seq)
+      vTaskDelay(1);
+}
+
+esp_err_t ebtn_registry_init(ebtn_registry_t* reg, _Atomic(void*)* storage, uint16_t capacity, size_t index_offset, ebtn_epoch_t* epoch) {
+#if CONFIG_EBTN_REGISTRY_DYNAMIC
+   if (!storage) {
+      storage = malloc(capacity * sizeof(*storage));
+      if (!storage)
+         return ESP_ERR_NO_MEM;
+   }
+#endif
+
+   atomic_init(&reg->items, storage);
+   atomic_init(&reg->count, 0);
+   atomic_init(&reg->moving, NULL);
+   reg->capacity = capacity;
+   reg->index_offset = index_offset;
+   reg->epoch = epoch;
+
+   return ESP_OK;
+}
+
+void ebtn_registry_deinit(ebtn_registry_t* reg) {
+#if CONFIG_EBTN_REGISTRY_DYNAMIC
+   free(atomic_load(&reg->items));
+#endif
+   atomic_store(&reg->items, NULL);
+   atomic_store(&reg->count, 0);
+   reg->capacity = 0;
+}
+
+#if CONFIG_EBTN_REGISTRY_DYNAMIC
+static esp_err_t grow(ebtn_registry_t* reg) {
+   if (reg->capacity > UINT16_MAX / 2)
+      return ESP_ERR_NO_MEM;
+
+   const uint16_t capacity = reg->capacity * 2;
+   _Atomic(void*)* old = atomic_load_explicit(&reg->items, memory_order_relaxed);
+   _Atomic(void*)* items = malloc(capacity * sizeof(*items));
+   if (!items)
+      return ESP_ERR_NO_MEM;
+
+   const uint16_t count = atomic_load_explicit(&reg->count, memory_order_relaxed);
+   for (uint16_t i = 0; i < count; i++)
+      atomic_init(&items[i], atomic_load_explicit(&old[i], memory_order_relaxed));
+
+   atomic_store(&reg->items, items);
+   reg->capacity = capacity;
+
+   // a poll may still be walking the old array
+   ebtn_epoch_synchronize(reg->epoch);
+   free(old);
+   return ESP_OK;
+}
+#endif
+
+esp_err_t ebtn_registry_add(ebtn_registry_t* reg, void* item) {
+   if (ebtn_registry_contains(reg, item))
+      return ESP_ERR_INVALID_STATE;
+
+   const uint16_t count = atomic_load_explicit(&reg->count, memory_order_relaxed);
+   if (count == reg->capacity) {
+#if CONFIG_EBTN_REGISTRY_DYNAMIC
+      const esp_err_t err = grow(reg);
+      if (err != ESP_OK)
+         return err;
+#else
+      return ESP_ERR_NO_MEM;
+#endif
+   }
+
+   *INDEX(reg, item) = count;
+   atomic_store(&ebtn_registry_items(reg)[count], item);
+   atomic_store(&reg->count, count + 1);
+   return ESP_OK;
+}
+
+esp_err_t ebtn_registry_remove(ebtn_registry_t* reg, void* item) {
+   if (!ebtn_registry_contains(reg, item))
+      return ESP_ERR_INVALID_ARG;
+
+   _Atomic(void*)* items = ebtn_registry_items(reg);
+   const uint16_t last = atomic_load_explicit(&reg->count, memory_order_relaxed) - 1;
+   const uint16_t index = *INDEX(reg, item);
+
+   // Move the last device into the freed position. A poll that loaded the count before the store below finds the moved
+   // device at both positions, ebtn_registry_next() skips the second one as long as it is marked as moving. The last
+   // position is left as is (not cleared), so such a poll can't miss it either.
+   void* moved = atomic_load_explicit(&items[last], memory_order_relaxed);
+   atomic_store(&reg->moving, moved);
+   *INDEX(reg, moved) = index;
+   atomic_store(&items[index], moved);
+   atomic_store(&reg->count, last);
+
+   // no poll started after the count store can see the moved device twice
+   ebtn_epoch_synchronize(reg->epoch);
+   atomic_store(&reg->moving, NULL);
+   return ESP_OK;
+}
+
+bool ebtn_registry_contains(ebtn_registry_t* reg, void* item) {
+   // index of a device that was never added is garbage, the pointer comparison rejects it
+   const uint16_t index = *INDEX(reg, item);
+   return index < atomic_load_explicit(&reg->count, memory_order_relaxed) &&
+          atomic_load_explicit(&ebtn_registry_items(reg)[index], memory_order_relaxed) == item;
+}
+
+bool ebtn_registry_full(ebtn_registry_t* reg) {
+#if CONFIG_EBTN_REGISTRY_DYNAMIC
+   return false;
+#else
+   return atomic_load_explicit(&reg->count, memory_order_relaxed) == reg->capacity;
+#endif
+}
@@ -0,0 +1,103 @@
+#include "ebtn_ring.h"
+
+#include <sdkconfig.h>
+#include <string.h>
+
+void ebtn_ring_init(ebtn_ring_t* ring, void* buf, void* overflow, size_t item_size, uint32_t length, ebtn_ring_merge_cb_t merge) {
+   ring->buf = buf;
+   ring->item_size = item_size;
+   ring->mask = length - 1;
+   ring->merge = merge;
+   ring->overflow_pending = false;
+   ring->overflow_sealed = false;
+   ring->overflow = overflow;
+
+   atomic_init(&ring->head, 0);
+   atomic_init(&ring->tail, 0);
+   atomic_init(&ring->dropped, 0);
+}
+
+static bool ring_write(ebtn_ring_t* ring, const void* item) {
+   const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+   uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+   if (head - tail > ring->mask) { // full
+#if CONFIG_EBTN_EVENT_RING_OVERFLOW_DROP_OLDEST
+      // a failed exchange means the consumer just freed a slot, so there is room either way
+      if (atomic_compare_exchange_strong_explicit(&ring->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_acquire))
+         atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+#else
+      return false;
+#endif
+   }
+
+   memcpy(ring->buf + (head & ring->mask) * ring->item_size, item, ring->item_size);
+   atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+   return true;
+}
+
+bool ebtn_ring_flush(ebtn_ring_t* ring) {
+#if CONFIG_EBTN_EVENT_RING_OVERFLOW_COALESCE
+   if (ring->overflow_pending && ring_write(ring, ring->overflow)) {
+      ring->overflow_pending = false;
+      return true;
+   }
+#endif
+   return false;
+}
+
+bool ebtn_ring_push(ebtn_ring_t* ring, const void* item) {
+#if CONFIG_EBTN_EVENT_RING_OVERFLOW_COALESCE
+   ebtn_ring_flush(ring); // keep ordering, the held event is older
+
+   if (!ring->overflow_pending) {
+      if (ring_write(ring, item))
+         return true;
+
+      memcpy(ring->overflow, item, ring->item_size);
+      ring->overflow_pending = true;
+      ring->overflow_sealed = false;
+      return true;
+   }
+
+   // only merge events that directly follow the held one, merging past a discarded event would reorder it
+   // (e.g. PRESSED, RELEASED discarded, PRESSED merged reads as two presses without a release)
+   if (!ring->overflow_sealed && ring->merge && ring->merge(ring->overflow, item))
+      return true;
+
+   ring->overflow_sealed = true;
+   atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+   return false;
+#elif CONFIG_EBTN_EVENT_RING_OVERFLOW_DROP_OLDEST
+   return ring_write(ring, item);
+#else
+   if (ring_write(ring, item))
+      return true;
+
+   atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+   return false;
+#endif
+}
+
+size_t ebtn_ring_pop(ebtn_ring_t* ring, void* out, size_t n) {
+   uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+   while (true) {
+      const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+      size_t count = head - tail;
+      if (count > ring->mask + 1) // producer is mid drop-oldest, the exchange below will fail
+         count = ring->mask + 1;
+      if (count > n)
+         count = n;
+      if (!count)
+         return 0;
+
+      for (size_t i = 0; i < count; i++)
+         memcpy((uint8_t*)out + i * ring->item_size, ring->buf + ((tail + i) & ring->mask) * ring->item_size, ring->item_size);
+
+      // fails only if the producer dropped the oldest event meanwhile, in which case the copy may be torn, so retry
+      if (atomic_compare_exchange_strong_explicit(&ring->tail, &tail, tail + count, memory_order_acq_rel, memory_order_acquire))
+         return count;
+   }
+}
@@ -0,0 +1,86 @@
+#include "shift_register.h"
+
+#include <esp_check.h>
+#include <string.h>
+
+#include "ebtn_hal.h"
+
+static const char* TAG = "ebtn-shift-register";
+
+static esp_err_t bitbang(shift_register_t* sr, uint8_t* buf, size_t len) {
+   // latch the inputs, the register nearest the MCU then presents its last input on the data pin
+   ebtn_hal_gpio_set_level(sr->load_pin, 0);
+   ebtn_hal_gpio_set_level(sr->load_pin, 1);
+
+   for (size_t i = 0; i < len; i++) {
+      uint8_t byte = 0;
+      for (int8_t bit = 7; bit >= 0; bit--) {
+         byte |= ebtn_hal_gpio_get_level(sr->data_pin) << bit;
+         ebtn_hal_gpio_set_level(sr->clock_pin, 1);
+         ebtn_hal_gpio_set_level(sr->clock_pin, 0);
+      }
+      buf[i] = byte;
+   }
+
+   return ESP_OK;
+}
+
+// a mask worth of inputs starting at the given byte, little endian
+inline static ebtn_mask_t read_mask(const shift_register_t* sr, size_t byte) {
+   const size_t len = sr->inputs / 8;
+
+   ebtn_mask_t mask = 0;
+   for (size_t i = 0; i < sizeof(ebtn_mask_t) && byte + i < len; i++)
+      mask |= (ebtn_mask_t)sr->buf[byte + i] << (8 * i);
+   return mask;
+}
+
+// gathers the even bits of x into its lower half
+inline static ebtn_mask_t even_bits(ebtn_mask_t x) {
+#if CONFIG_EBTN_PORT_MASK_64
+   x &= 0x5555555555555555ULL;
+   x = (x | (x >> 1)) & 0x3333333333333333ULL;
+   x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+   x = (x | (x >> 4)) & 0x00ff00ff00ff00ffULL;
+   x = (x | (x >> 8)) & 0x0000ffff0000ffffULL;
+   x = (x | (x >> 16)) & 0x00000000ffffffffULL;
+#else
+   x &= 0x55555555UL;
+   x = (x | (x >> 1)) & 0x33333333UL;
+   x = (x | (x >> 2)) & 0x0f0f0f0fUL;
+   x = (x | (x >> 4)) & 0x00ff00ffUL;
+   x = (x | (x >> 8)) & 0x0000ffffUL;
+#endif
+   return x;
+}
+
+esp_err_t shift_register_init(shift_register_t* sr) {
+   ESP_RETURN_ON_FALSE(sr && sr->buf && sr->inputs && !(sr->inputs % 8), ESP_ERR_INVALID_ARG, TAG, "Invalid arg");
+
+   memset(sr->buf, 0, sr->inputs / 8);
+
+   if (!sr->transfer_callback) {
+      ESP_RETURN_ON_ERROR(ebtn_hal_gpio_output_init(sr->load_pin, false, 1), TAG, "Failed to init load GPIO");
+      ESP_RETURN_ON_ERROR(ebtn_hal_gpio_output_init(sr->clock_pin, false, 0), TAG, "Failed to init clock GPIO");
+      ESP_RETURN_ON_ERROR(ebtn_hal_gpio_input_init(sr->data_pin, false, false), TAG, "Failed to init data GPIO");
+      sr->transfer_callback = bitbang;
+   }
+
+   return ESP_OK;
+}
+
+esp_err_t shift_register_update(shift_register_t* sr) {
+   return sr->transfer_callback(sr, sr->buf, sr->inputs / 8);
+}
+
+ebtn_mask_t shift_register_poll_button_port(uint8_t port, void* ctx) {
+   return read_mask(ctx, port);
+}
+
+void shift_register_poll_encoder_port(uint8_t port, void* ctx, ebtn_mask_t* a, ebtn_mask_t* b) {
+   const ebtn_mask_t lo = read_mask(ctx, port);
+   const ebtn_mask_t hi = read_mask(ctx, port + sizeof(ebtn_mask_t));
+
+   *a = even_bits(lo) | (even_bits(hi) << (EBTN_MASK_BITS / 2));
+   *b = even_bits(lo >> 1) | (even_bits(hi >> 1) << (EBTN_MASK_BITS / 2));
+}
@@ -0,0 +1,64 @@
+#include "ebtn_snapshot.h"
+
+#include <string.h>
+
+#if CONFIG_EBTN_SNAPSHOT
+ebtn_snapshot_t ebtn_snapshot = {0};
+atomic_uint ebtn_snapshot_seq = 0;
+portMUX_TYPE ebtn_snapshot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// ids with a slot that a device has claimed, bit n for id n
+static uint64_t pressed_ids = 0;
+static uint64_t position_ids = 0;
+
+static bool claim(uint64_t* ids, uint8_t id, uint8_t max) {
+   if (!id || id > max)
+      return true;
+
+   bool claimed = false;
+   portENTER_CRITICAL(&ebtn_snapshot_lock);
+   if (!(*ids & (1ULL << id))) {
+      *ids |= 1ULL << id;
+      claimed = true;
+   }
+   portEXIT_CRITICAL(&ebtn_snapshot_lock);
+   return claimed;
+}
+
+static void release(uint64_t* ids, uint8_t id, uint8_t max) {
+   if (!id || id > max)
+      return;
+
+   portENTER_CRITICAL(&ebtn_snapshot_lock);
+   *ids &= ~(1ULL << id);
+   portEXIT_CRITICAL(&ebtn_snapshot_lock);
+}
+
+bool ebtn_snapshot_claim_pressed(uint8_t id) {
+   return claim(&pressed_ids, id, 63);
+}
+
+void ebtn_snapshot_release_pressed(uint8_t id) {
+   release(&pressed_ids, id, 63);
+}
+
+bool ebtn_snapshot_claim_position(uint8_t id) {
+   return claim(&position_ids, id, CONFIG_EBTN_SNAPSHOT_ENCODERS);
+}
+
+void ebtn_snapshot_release_position(uint8_t id) {
+   release(&position_ids, id, CONFIG_EBTN_SNAPSHOT_ENCODERS);
+}
+
+void ebtn_get_snapshot(ebtn_snapshot_t* snapshot) {
+   unsigned seq;
+
+   do {
+      while ((seq = atomic_load_explicit(&ebtn_snapshot_seq, memory_order_acquire)) & 1)
+         ; // writers hold a spinlock, so this only spins for the length of one update
+
+      memcpy(snapshot, &ebtn_snapshot, sizeof(ebtn_snapshot_t));
+      atomic_thread_fence(memory_order_acquire); // copy completes before the sequence is checked again
+   } while (atomic_load_explicit(&ebtn_snapshot_seq, memory_order_relaxed) != seq);
+}
+#endif
@@ -0,0 +1,23 @@
+#include "ebtn_stats.h"
+
+#include <limits.h>
+#include <string.h>
+
+#if CONFIG_EBTN_STATS
+#define STATS_INIT {.time_min_us = UINT32_MAX, .jitter_min_us = INT32_MAX, .jitter_max_us = INT32_MIN}
+
+ebtn_stats_t ebtn_stats = {.buttons = STATS_INIT, .encoders = STATS_INIT};
+portMUX_TYPE ebtn_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void ebtn_get_stats(ebtn_stats_t* stats) {
+   portENTER_CRITICAL(&ebtn_stats_lock);
+   memcpy(stats, &ebtn_stats, sizeof(ebtn_stats_t));
+   portEXIT_CRITICAL(&ebtn_stats_lock);
+}
+
+void ebtn_reset_stats() {
+   portENTER_CRITICAL(&ebtn_stats_lock);
+   ebtn_stats = (ebtn_stats_t){.buttons = STATS_INIT, .encoders = STATS_INIT};
+   portEXIT_CRITICAL(&ebtn_stats_lock);
+}
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Cost per poll of N encoders decoded one by one through poll_state_callback, against the same N encoders decoded together
+ * by the bit-sliced port decoder. Both paths see the same A/B waveforms and must count the same steps.
+ *
+ * Times are host ns per poll including the simulated timer dispatch and the prepoll that generates the waveforms, the
+ * "none" row is that overhead alone.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <encoder.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define TICKS 200000
+#define MAX_ENCODERS 32
+
+static const uint8_t gray[4] = {0b00, 0b01, 0b11, 0b10}; // clockwise A/B sequence
+
+static rotary_encoder_t encoders[MAX_ENCODERS];
+static int encoder_count;
+static uint32_t tick;
+
+static uint8_t levels[MAX_ENCODERS * 2]; // A of encoder n at pin 2n, B at 2n + 1
+static ebtn_mask_t port_a, port_b;
+
+static int32_t steps[MAX_ENCODERS];
+static QueueHandle_t queue; // unused, events go to on_event()
+
+// encoder n turns every n % 3 + 1 polls, odd encoders counterclockwise
+static void waveform() {
+   port_a = 0;
+   port_b = 0;
+   for (int i = 0; i < encoder_count; i++) {
+      const uint32_t phase = tick / (i % 3 + 1);
+      const uint8_t ab = gray[(i & 1 ? -phase : phase) & 3];
+      levels[2 * i] = ab >> 1;
+      levels[2 * i + 1] = ab & 1;
+      port_a |= (ebtn_mask_t)(ab >> 1) << i;
+      port_b |= (ebtn_mask_t)(ab & 1) << i;
+   }
+   tick++;
+}
+
+static uint8_t read_pin(gpio_num_t pin) {
+   return levels[pin];
+}
+
+static void read_port(uint8_t port, void* ctx, ebtn_mask_t* a, ebtn_mask_t* b) {
+   *a = port_a;
+   *b = port_b;
+}
+
+static void on_event(const rotary_encoder_event_t* e) {
+   steps[e->sender - encoders] += e->dir;
+}
+
+static double now_ns() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// runs TICKS polls of count encoders, on the port if port is set, returns ns per poll
+static double run(int count, rotary_encoder_port_t* port) {
+   mock_hal_reset();
+   memset(encoders, 0, sizeof(encoders));
+   memset(steps, 0, sizeof(steps));
+   encoder_count = count;
+   tick = 0;
+
+   CHECK_EQ(rotary_encoder_init(queue), ESP_OK);
+   rotary_encoder_set_event_callback(on_event);
+   rotary_encoder_set_prepoll_callback(waveform);
+
+   for (int i = 0; i < count; i++) {
+      encoders[i].pin_a = port ? i : 2 * i;
+      encoders[i].pin_b = port ? i : 2 * i + 1;
+      encoders[i].poll_state_callback = read_pin;
+      encoders[i].port = port;
+      CHECK_EQ(rotary_encoder_add(&encoders[i]), ESP_OK);
+   }
+
+   const double start = now_ns();
+   mock_hal_advance((int64_t)TICKS * CONFIG_EBTN_POLLING_INTERVAL_US_ENC);
+   const double ns = (now_ns() - start) / TICKS;
+
+   CHECK_EQ(mock_hal_timer_calls, TICKS);
+
+   for (int i = 0; i < count; i++)
+      CHECK_EQ(rotary_encoder_remove(&encoders[i]), ESP_OK);
+   CHECK_EQ(rotary_encoder_free(), ESP_OK);
+   return ns;
+}
+
+int main() {
+   rotary_encoder_port_t port = {.poll_port_callback = read_port};
+   queue = xQueueCreate(1, sizeof(rotary_encoder_event_t));
+   static const int counts[] = {1, 4, 8, 16, 32};
+
+   printf("%9s %14s %14s\n", "encoders", "ns/poll each", "ns/poll port");
+   printf("%9s %14.1f %14s\n", "none", run(0, NULL), "-");
+
+   for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+      const int count = counts[c];
+
+      const double each_ns = run(count, NULL);
+      int32_t each_steps[MAX_ENCODERS];
+      memcpy(each_steps, steps, sizeof(steps));
+
+      const double port_ns = run(count, &port);
+
+      printf("%9d %14.1f %14.1f\n", count, each_ns, port_ns);
+
+      for (int i = 0; i < count; i++) {
+         // full steps complete at 11, two transitions into each cycle of four
+         const int32_t expected = ((TICKS - 1) / (i % 3 + 1) + 2) / 4;
+         CHECK_EQ(steps[i], each_steps[i]);
+         CHECK_EQ(i & 1 ? -each_steps[i] : each_steps[i], expected);
+      }
+   }
+
+   vQueueDelete(queue);
+   return TEST_RESULT();
+}
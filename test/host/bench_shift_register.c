@@ -0,0 +1,198 @@
+/*
+ * Shift register chain against a simulated 74HC165 chain on the builtin bit-banged transfer: chain order, button and encoder
+ * port mapping, and buttons/encoders decoded from it end to end. Then the throughput of 8 to 256 input chains, bit-banged
+ * and through a transfer callback (a memcpy, the host stand-in for an SPI DMA receive), and of mapping them onto ports.
+ *
+ * Host times only compare the paths against each other, bit-banging on a target is bound by the GPIO and clock speed.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <encoder.h>
+#include <shift_register.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define MAX_INPUTS 256
+#define PIN_LOAD 1
+#define PIN_CLOCK 2
+#define PIN_DATA 3
+
+// Simulated chain: a falling load latches the inputs, the data pin presents the next bit of the chain, MSB of the register
+// nearest the MCU first, and a rising clock shifts by one
+static uint8_t inputs[MAX_INPUTS / 8]; // input n is bit n % 8 of byte n / 8
+static uint16_t chain_inputs;
+static uint8_t latched[MAX_INPUTS / 8];
+static uint16_t shifted;
+
+static void write_pin(gpio_num_t pin, uint8_t level) {
+   if (pin == PIN_LOAD && !level) {
+      memcpy(latched, inputs, sizeof(latched));
+      shifted = 0;
+   } else if (pin == PIN_CLOCK && level) {
+      shifted++;
+   }
+}
+
+static uint8_t read_pin(gpio_num_t pin) {
+   if (pin != PIN_DATA)
+      return mock_hal_level[pin];
+   if (shifted >= chain_inputs)
+      return 0; // serial input of the last register is grounded
+   return (latched[shifted / 8] >> (7 - shifted % 8)) & 1;
+}
+
+static void set_input(uint16_t n, bool level) {
+   inputs[n / 8] = (inputs[n / 8] & ~(1 << (n % 8))) | (level << (n % 8));
+}
+
+static esp_err_t dma_transfer(shift_register_t* sr, uint8_t* buf, size_t len) {
+   memcpy(buf, inputs, len);
+   return ESP_OK;
+}
+
+static double now_ns() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint8_t buf[MAX_INPUTS / 8];
+static shift_register_t sr = {.buf = buf, .load_pin = PIN_LOAD, .clock_pin = PIN_CLOCK, .data_pin = PIN_DATA};
+
+static void chain_init(uint16_t count, shift_register_transfer_cb_t transfer) {
+   chain_inputs = count;
+   sr.inputs = count;
+   sr.transfer_callback = transfer;
+   CHECK_EQ(shift_register_init(&sr), ESP_OK);
+}
+
+static void test_mapping() {
+   chain_init(64, NULL);
+   for (size_t i = 0; i < sizeof(inputs); i++)
+      inputs[i] = rand();
+
+   CHECK_EQ(shift_register_update(&sr), ESP_OK);
+   CHECK(!memcmp(buf, inputs, 64 / 8));
+
+   for (uint8_t port = 0; port < 64 / 8; port++) {
+      ebtn_mask_t expected = 0, a = 0, b = 0;
+      for (uint16_t bit = 0; bit < EBTN_MASK_BITS && port * 8 + bit < 64; bit++)
+         expected |= (ebtn_mask_t)((inputs[port + bit / 8] >> (bit % 8)) & 1) << bit;
+      CHECK_EQ(shift_register_poll_button_port(port, &sr), expected);
+
+      // A/B interleaved from the first input of the port
+      ebtn_mask_t enc_a, enc_b;
+      shift_register_poll_encoder_port(port, &sr, &enc_a, &enc_b);
+      for (uint16_t enc = 0; enc < EBTN_MASK_BITS && port * 8 + 2 * enc + 1 < 64; enc++) {
+         const uint16_t input = port * 8 + 2 * enc;
+         a |= (ebtn_mask_t)((inputs[input / 8] >> (input % 8)) & 1) << enc;
+         b |= (ebtn_mask_t)((inputs[(input + 1) / 8] >> ((input + 1) % 8)) & 1) << enc;
+      }
+      CHECK_EQ(enc_a, a);
+      CHECK_EQ(enc_b, b);
+   }
+}
+
+static void prepoll() {
+   shift_register_update(&sr);
+}
+
+// a button on input 11 (port 1, pin 3) and an encoder on inputs 4/5 (port 0, encoder 2) of a 16 input chain
+static void test_end_to_end() {
+   memset(inputs, 0, sizeof(inputs));
+   chain_init(16, NULL);
+   mock_hal_reset();
+   mock_hal_set_gpio(read_pin, write_pin);
+
+   QueueHandle_t btn_queue = xQueueCreate(4, sizeof(button_event_t));
+   QueueHandle_t enc_queue = xQueueCreate(4, sizeof(rotary_encoder_event_t));
+   button_port_t btn_port = {.poll_port_callback = shift_register_poll_button_port, .port = 1, .ctx = &sr};
+   rotary_encoder_port_t enc_port = {.poll_port_callback = shift_register_poll_encoder_port, .port = 0, .ctx = &sr};
+   button_t btn = {.port = &btn_port, .pin = 3};
+   rotary_encoder_t enc = {.port = &enc_port, .pin_a = 2};
+
+   CHECK_EQ(button_init(btn_queue), ESP_OK);
+   CHECK_EQ(rotary_encoder_init(enc_queue), ESP_OK);
+   button_set_prepoll_callback(prepoll);
+   rotary_encoder_set_prepoll_callback(prepoll);
+   CHECK_EQ(button_add(&btn), ESP_OK);
+   CHECK_EQ(rotary_encoder_add(&enc), ESP_OK);
+
+   set_input(11, 1);
+   mock_hal_advance(50000);
+   button_event_t be;
+   CHECK(xQueueReceive(btn_queue, &be, 0) && be.sender == &btn && be.type == BUTTON_PRESSED);
+
+   static const uint8_t cycle[4] = {0b01, 0b11, 0b10, 0b00}; // clockwise
+   for (int i = 0; i < 4; i++) {
+      set_input(4, cycle[i] >> 1);
+      set_input(5, cycle[i] & 1);
+      mock_hal_advance(CONFIG_EBTN_POLLING_INTERVAL_US_ENC);
+   }
+   rotary_encoder_event_t ee;
+   CHECK(xQueueReceive(enc_queue, &ee, 0) && ee.sender == &enc && ee.dir == ROT_CLOCKWISE);
+   CHECK(!xQueueReceive(enc_queue, &ee, 0));
+
+   CHECK_EQ(button_remove(&btn), ESP_OK);
+   CHECK_EQ(rotary_encoder_remove(&enc), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+   CHECK_EQ(rotary_encoder_free(), ESP_OK);
+   vQueueDelete(btn_queue);
+   vQueueDelete(enc_queue);
+   mock_hal_set_gpio(NULL, NULL);
+}
+
+#define ROUNDS 20000
+
+static volatile ebtn_mask_t sink;
+
+static double bench_update(uint16_t count, shift_register_transfer_cb_t transfer) {
+   chain_init(count, transfer);
+
+   const double start = now_ns();
+   for (int i = 0; i < ROUNDS; i++)
+      shift_register_update(&sr);
+   return (now_ns() - start) / ROUNDS;
+}
+
+// every input mapped once onto button ports, and once onto encoder ports
+static double bench_map(uint16_t count) {
+   const uint8_t bytes = count / 8;
+   ebtn_mask_t a, b;
+
+   const double start = now_ns();
+   for (int i = 0; i < ROUNDS; i++) {
+      for (uint8_t port = 0; port < bytes; port += sizeof(ebtn_mask_t))
+         sink = shift_register_poll_button_port(port, &sr);
+      for (uint8_t port = 0; port < bytes; port += 2 * sizeof(ebtn_mask_t)) {
+         shift_register_poll_encoder_port(port, &sr, &a, &b);
+         sink = a ^ b;
+      }
+   }
+   return (now_ns() - start) / ROUNDS;
+}
+
+int main() {
+   mock_hal_reset();
+   mock_hal_set_gpio(read_pin, write_pin);
+
+   test_mapping();
+   test_end_to_end();
+
+   mock_hal_set_gpio(read_pin, write_pin);
+   bench_update(MAX_INPUTS, NULL); // warm up
+   bench_map(MAX_INPUTS);
+
+   printf("%7s %17s %18s %14s\n", "inputs", "bit-bang ns/read", "transfer ns/read", "map ns/read");
+   for (uint16_t count = 8; count <= MAX_INPUTS; count *= 2) {
+      const double bitbang_ns = bench_update(count, NULL);
+      const double transfer_ns = bench_update(count, dma_transfer);
+      const double map_ns = bench_map(count);
+      printf("%7u %17.1f %18.1f %14.1f\n", count, bitbang_ns, transfer_ns, map_ns);
+   }
+
+   return TEST_RESULT();
+}
@@ -0,0 +1,313 @@
+#include "mock_hal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "ebtn.h"
+
+#define MAX_TIMERS 16
+
+struct ebtn_hal_timer {
+   ebtn_hal_cb_t callback;
+   void* arg;
+   bool used;
+   bool running;
+   bool once; // deleted after running
+   uint64_t period_us;
+   int64_t due_us;
+   uint32_t seq; // start order, breaks ties between timers due at the same time
+};
+
+int64_t mock_hal_now_us;
+uint8_t mock_hal_level[GPIO_NUM_MAX];
+int64_t mock_hal_timer_busy_us;
+uint32_t mock_hal_timer_calls;
+TickType_t mock_hal_mutex_wait;
+
+static struct ebtn_hal_timer timers[MAX_TIMERS];
+static uint32_t seq;
+
+static mock_hal_read_cb_t read_hook;
+static mock_hal_write_cb_t write_hook;
+
+static ebtn_hal_cb_t isr_handlers[GPIO_NUM_MAX];
+static void* isr_args[GPIO_NUM_MAX];
+
+static ebtn_clock_cb_t clock_cb;
+
+void mock_hal_reset() {
+   mock_hal_now_us = 0;
+   memset(mock_hal_level, 0, sizeof(mock_hal_level));
+   mock_hal_timer_busy_us = 0;
+   mock_hal_timer_calls = 0;
+   mock_hal_mutex_wait = 0;
+   memset(timers, 0, sizeof(timers));
+   read_hook = NULL;
+   write_hook = NULL;
+   memset(isr_handlers, 0, sizeof(isr_handlers));
+}
+
+void mock_hal_set_gpio(mock_hal_read_cb_t read, mock_hal_write_cb_t write) {
+   read_hook = read;
+   write_hook = write;
+}
+
+static struct ebtn_hal_timer* next_due(int64_t until_us) {
+   struct ebtn_hal_timer* next = NULL;
+   for (int i = 0; i < MAX_TIMERS; i++) {
+      struct ebtn_hal_timer* t = &timers[i];
+      if (!t->used || !t->running || t->due_us > until_us)
+         continue;
+      if (!next || t->due_us < next->due_us || (t->due_us == next->due_us && t->seq < next->seq))
+         next = t;
+   }
+   return next;
+}
+
+void mock_hal_advance(int64_t us) {
+   const int64_t until_us = mock_hal_now_us + us;
+
+   struct ebtn_hal_timer* t;
+   while ((t = next_due(until_us))) {
+      if (t->due_us > mock_hal_now_us)
+         mock_hal_now_us = t->due_us;
+
+      // rescheduled before the call, so the callback can stop or restart its own timer. Like esp_timer, expirations
+      // missed while a callback ran are caught up back to back.
+      if (t->once) {
+         t->running = false;
+         t->used = false;
+      } else {
+         t->due_us += t->period_us;
+      }
+
+      const int64_t start_us = mock_hal_now_us;
+      t->callback(t->arg);
+      mock_hal_timer_busy_us += mock_hal_now_us - start_us;
+      mock_hal_timer_calls++;
+   }
+
+   if (until_us > mock_hal_now_us)
+      mock_hal_now_us = until_us;
+}
+
+void mock_hal_busy(uint32_t us) {
+   mock_hal_now_us += us;
+}
+
+void mock_hal_schedule(int64_t us, ebtn_hal_cb_t callback, void* arg) {
+   for (int i = 0; i < MAX_TIMERS; i++) {
+      if (!timers[i].used) {
+         timers[i] = (struct ebtn_hal_timer){.callback = callback, .arg = arg, .used = true, .running = true, .once = true};
+         timers[i].due_us = mock_hal_now_us + us;
+         timers[i].seq = seq++;
+         return;
+      }
+   }
+   abort();
+}
+
+void mock_hal_gpio_edge(gpio_num_t pin, uint8_t level) {
+   mock_hal_level[pin] = level;
+   if (isr_handlers[pin])
+      isr_handlers[pin](isr_args[pin]);
+}
+
+int mock_hal_timers_running() {
+   int running = 0;
+   for (int i = 0; i < MAX_TIMERS; i++)
+      running += timers[i].used && timers[i].running && !timers[i].once;
+   return running;
+}
+
+// ebtn_hal.h
+
+void ebtn_set_clock(ebtn_clock_cb_t callback) {
+   clock_cb = callback;
+}
+
+int64_t ebtn_hal_time_us() {
+   return clock_cb ? clock_cb() : mock_hal_now_us;
+}
+
+esp_err_t ebtn_hal_gpio_input_init(gpio_num_t pin, bool internal_pull, bool active_low) {
+   if (internal_pull && !read_hook)
+      mock_hal_level[pin] = active_low;
+   return ESP_OK;
+}
+
+uint8_t ebtn_hal_gpio_get_level(gpio_num_t pin) {
+   return read_hook ? read_hook(pin) : mock_hal_level[pin];
+}
+
+esp_err_t ebtn_hal_gpio_output_init(gpio_num_t pin, bool open_drain, uint8_t level) {
+   ebtn_hal_gpio_set_level(pin, level);
+   return ESP_OK;
+}
+
+void ebtn_hal_gpio_set_level(gpio_num_t pin, uint8_t level) {
+   mock_hal_level[pin] = level;
+   if (write_hook)
+      write_hook(pin, level);
+}
+
+void ebtn_hal_delay_us(uint32_t us) {
+   mock_hal_busy(us);
+}
+
+esp_err_t ebtn_hal_gpio_isr_add(gpio_num_t pin, ebtn_hal_cb_t handler, void* arg) {
+   isr_handlers[pin] = handler;
+   isr_args[pin] = arg;
+   return ESP_OK;
+}
+
+esp_err_t ebtn_hal_gpio_isr_remove(gpio_num_t pin) {
+   isr_handlers[pin] = NULL;
+   return ESP_OK;
+}
+
+esp_err_t ebtn_hal_timer_create(const char* name, ebtn_hal_cb_t callback, void* arg, ebtn_hal_timer_t* out_timer) {
+   for (int i = 0; i < MAX_TIMERS; i++) {
+      if (!timers[i].used) {
+         timers[i] = (struct ebtn_hal_timer){.callback = callback, .arg = arg, .used = true};
+         *out_timer = &timers[i];
+         return ESP_OK;
+      }
+   }
+   return ESP_ERR_NO_MEM;
+}
+
+#if CONFIG_EBTN_POLL_TASK
+esp_err_t ebtn_hal_timer_create_task(const char* name, ebtn_hal_cb_t callback, void* arg, const ebtn_task_config_t* task, ebtn_hal_timer_t* out_timer) {
+   return ebtn_hal_timer_create(name, callback, arg, out_timer);
+}
+#endif
+
+esp_err_t ebtn_hal_timer_delete(ebtn_hal_timer_t timer) {
+   timer->used = false;
+   timer->running = false;
+   return ESP_OK;
+}
+
+esp_err_t ebtn_hal_timer_start_periodic(ebtn_hal_timer_t timer, uint64_t period_us) {
+   if (timer->running)
+      return ESP_ERR_INVALID_STATE;
+
+   timer->running = true;
+   timer->period_us = period_us;
+   timer->due_us = mock_hal_now_us + period_us;
+   timer->seq = seq++;
+   return ESP_OK;
+}
+
+esp_err_t ebtn_hal_timer_restart(ebtn_hal_timer_t timer, uint64_t period_us) {
+   if (!timer->running)
+      return ESP_ERR_INVALID_STATE;
+
+   timer->period_us = period_us;
+   timer->due_us = mock_hal_now_us + period_us;
+   return ESP_OK;
+}
+
+esp_err_t ebtn_hal_timer_stop(ebtn_hal_timer_t timer) {
+   if (!timer->running)
+      return ESP_ERR_INVALID_STATE;
+
+   timer->running = false;
+   return ESP_OK;
+}
+
+// FreeRTOS, single threaded
+
+struct QueueDefinition {
+   UBaseType_t length;
+   UBaseType_t item_size;
+   UBaseType_t count;
+   UBaseType_t head;
+   bool taken; // mutexes
+   uint8_t items[];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+   QueueHandle_t queue = calloc(1, sizeof(struct QueueDefinition) + length * item_size);
+   queue->length = length;
+   queue->item_size = item_size;
+   return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+   free(queue);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t wait) {
+   if (queue->count == queue->length)
+      return pdFALSE;
+
+   memcpy(queue->items + ((queue->head + queue->count) % queue->length) * queue->item_size, item, queue->item_size);
+   queue->count++;
+   return pdTRUE;
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken) {
+   return xQueueSendToBack(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait) {
+   if (!queue->count)
+      return pdFALSE;
+
+   memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+   queue->head = (queue->head + 1) % queue->length;
+   queue->count--;
+   return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+   return xQueueCreate(0, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t mutex) {
+   vQueueDelete(mutex);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait) {
+   mock_hal_mutex_wait = wait;
+   if (mutex->taken)
+      return pdFALSE;
+
+   mutex->taken = true;
+   return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+   if (!mutex->taken)
+      return pdFALSE;
+
+   mutex->taken = false;
+   return pdTRUE;
+}
+
+static uint32_t notifications;
+
+void vTaskDelay(TickType_t ticks) {
+   mock_hal_now_us += ticks * 1000;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+   return (TaskHandle_t)&notifications;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+   notifications++;
+   return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+   const uint32_t value = notifications;
+   notifications = clear ? 0 : (value ? value - 1 : 0);
+   return value;
+}
@@ -0,0 +1,65 @@
+#ifndef _EBTN_MOCK_HAL_H
+#define _EBTN_MOCK_HAL_H
+
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+
+#include "ebtn_hal.h"
+
+/*
+ * Host implementation of ebtn_hal.h and of the few FreeRTOS calls the engines make.
+ *
+ * Time only moves through mock_hal_advance() (and ebtn_hal_delay_us(), which models a busy wait in the calling context).
+ * Timers are simulated: mock_hal_advance() runs every expiration in order at its due time, from the calling thread, so the
+ * polls of a test run deterministically. Time spent in timer callbacks (busy waits, or mock_hal_busy() in a callback) is
+ * accumulated in mock_hal_timer_busy_us, the host equivalent of timer task occupancy.
+ */
+
+typedef uint8_t (*mock_hal_read_cb_t)(gpio_num_t pin);
+typedef void (*mock_hal_write_cb_t)(gpio_num_t pin, uint8_t level);
+
+extern int64_t mock_hal_now_us;
+extern uint8_t mock_hal_level[GPIO_NUM_MAX]; // pin levels, read by ebtn_hal_gpio_get_level() unless a read hook is set
+
+extern int64_t mock_hal_timer_busy_us; // time spent in timer callbacks
+extern uint32_t mock_hal_timer_calls;  // timer callbacks run
+
+extern TickType_t mock_hal_mutex_wait; // wait of the last xSemaphoreTake()
+
+/**
+ * @brief Resets time, pins, hooks, timers and counters
+ */
+void mock_hal_reset();
+
+/**
+ * @brief Routes pin reads and writes through callbacks (e.g. a simulated shift register or key matrix), NULL to use mock_hal_level
+ */
+void mock_hal_set_gpio(mock_hal_read_cb_t read, mock_hal_write_cb_t write);
+
+/**
+ * @brief Advances time, running the timer callbacks that fall due in order
+ */
+void mock_hal_advance(int64_t us);
+
+/**
+ * @brief Consumes time in the calling context, e.g. a blocking bus transfer in a timer callback
+ */
+void mock_hal_busy(uint32_t us);
+
+/**
+ * @brief Runs callback once, us from now (e.g. the completion of a simulated bus transfer)
+ */
+void mock_hal_schedule(int64_t us, ebtn_hal_cb_t callback, void* arg);
+
+/**
+ * @brief Sets a pin level and runs its interrupt handler, if any
+ */
+void mock_hal_gpio_edge(gpio_num_t pin, uint8_t level);
+
+/**
+ * @brief Number of timers currently running
+ */
+int mock_hal_timers_running();
+
+#endif // _EBTN_MOCK_HAL_H
@@ -0,0 +1,12 @@
+#ifndef _EBTN_HOST_GPIO_H
+#define _EBTN_HOST_GPIO_H
+
+#include "esp_err.h"
+
+typedef enum {
+   GPIO_NUM_NC = -1,
+   GPIO_NUM_0 = 0,
+   GPIO_NUM_MAX = 64, // pins are only indices into the mock pin levels
+} gpio_num_t;
+
+#endif
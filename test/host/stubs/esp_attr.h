@@ -0,0 +1,7 @@
+#ifndef _EBTN_HOST_ESP_ATTR_H
+#define _EBTN_HOST_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef _EBTN_HOST_SDKCONFIG_H
+#define _EBTN_HOST_SDKCONFIG_H
+
+/*
+ * Kconfig defaults for host builds. Options are overridden per test target with compile definitions (see CMakeLists.txt),
+ * bool options are off unless defined there.
+ */
+
+#ifndef CONFIG_EBTN_REGISTRY_DYNAMIC
+#define CONFIG_EBTN_REGISTRY_STATIC 1
+#endif
+
+#if !CONFIG_EBTN_EVENT_RING_OVERFLOW_DROP_OLDEST && !CONFIG_EBTN_EVENT_RING_OVERFLOW_COALESCE
+#define CONFIG_EBTN_EVENT_RING_OVERFLOW_DROP_NEWEST 1
+#endif
+
+#ifndef CONFIG_EBTN_EVENT_RING_ORDER_BTN
+#define CONFIG_EBTN_EVENT_RING_ORDER_BTN 4
+#endif
+#ifndef CONFIG_EBTN_EVENT_RING_ORDER_ENC
+#define CONFIG_EBTN_EVENT_RING_ORDER_ENC 4
+#endif
+#ifndef CONFIG_EBTN_POLL_TASK_PRIORITY
+#define CONFIG_EBTN_POLL_TASK_PRIORITY 20
+#endif
+#ifndef CONFIG_EBTN_POLL_TASK_STACK
+#define CONFIG_EBTN_POLL_TASK_STACK 3072
+#endif
+#ifndef CONFIG_EBTN_POLL_TASK_CORE
+#define CONFIG_EBTN_POLL_TASK_CORE -1
+#endif
+#ifndef CONFIG_EBTN_SNAPSHOT_ENCODERS
+#define CONFIG_EBTN_SNAPSHOT_ENCODERS 4
+#endif
+#ifndef CONFIG_EBTN_ADAPTIVE_QUIET_MS
+#define CONFIG_EBTN_ADAPTIVE_QUIET_MS 1000
+#endif
+#ifndef CONFIG_EBTN_COMPACT_TICK_MS
+#define CONFIG_EBTN_COMPACT_TICK_MS 10
+#endif
+#ifndef CONFIG_EBTN_MAX_COUNT_BTN
+#define CONFIG_EBTN_MAX_COUNT_BTN 5
+#endif
+#ifndef CONFIG_EBTN_MAX_COUNT_BTN_GROUPS
+#define CONFIG_EBTN_MAX_COUNT_BTN_GROUPS 5
+#endif
+#ifndef CONFIG_EBTN_MAX_COUNT_BTN_PORTS
+#define CONFIG_EBTN_MAX_COUNT_BTN_PORTS 1
+#endif
+#ifndef CONFIG_EBTN_POLLING_INTERVAL_MS_BTN
+#define CONFIG_EBTN_POLLING_INTERVAL_MS_BTN 10
+#endif
+#ifndef CONFIG_EBTN_POLLING_IDLE_INTERVAL_MS_BTN
+#define CONFIG_EBTN_POLLING_IDLE_INTERVAL_MS_BTN 50
+#endif
+#ifndef CONFIG_EBTN_BTN_DEBOUNCE_MS
+#define CONFIG_EBTN_BTN_DEBOUNCE_MS 0
+#endif
+#ifndef CONFIG_EBTN_CLICK_MAX_MS
+#define CONFIG_EBTN_CLICK_MAX_MS 150
+#endif
+#ifndef CONFIG_EBTN_LONG_PRESS_MIN_MS
+#define CONFIG_EBTN_LONG_PRESS_MIN_MS 800
+#endif
+#ifndef CONFIG_EBTN_MAX_COUNT_ENC
+#define CONFIG_EBTN_MAX_COUNT_ENC 1
+#endif
+#ifndef CONFIG_EBTN_MAX_COUNT_ENC_PORTS
+#define CONFIG_EBTN_MAX_COUNT_ENC_PORTS 1
+#endif
+#ifndef CONFIG_EBTN_POLLING_INTERVAL_US_ENC
+#define CONFIG_EBTN_POLLING_INTERVAL_US_ENC 1000
+#endif
+#ifndef CONFIG_EBTN_POLLING_IDLE_INTERVAL_US_ENC
+#define CONFIG_EBTN_POLLING_IDLE_INTERVAL_US_ENC 10000
+#endif
+#ifndef CONFIG_EBTN_ENC_ISR_GLITCH_US
+#define CONFIG_EBTN_ENC_ISR_GLITCH_US 0
+#endif
+#ifndef CONFIG_EBTN_ENC_COALESCE_INTERVAL_US
+#define CONFIG_EBTN_ENC_COALESCE_INTERVAL_US 0
+#endif
+#ifndef CONFIG_EBTN_ENC_ACCEL_MIN_SPEED
+#define CONFIG_EBTN_ENC_ACCEL_MIN_SPEED 10
+#endif
+#ifndef CONFIG_EBTN_ENC_ACCEL_MAX_SPEED
+#define CONFIG_EBTN_ENC_ACCEL_MAX_SPEED 100
+#endif
+#ifndef CONFIG_EBTN_ENC_ACCEL_MAX_FACTOR
+#define CONFIG_EBTN_ENC_ACCEL_MAX_FACTOR 10
+#endif
+
+#endif
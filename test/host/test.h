@@ -0,0 +1,30 @@
+#ifndef _EBTN_TEST_H
+#define _EBTN_TEST_H
+
+#include <stdio.h>
+
+// minimal assertions for the host tests, main returns TEST_RESULT() so ctest sees failures
+
+static int test_failures;
+
+#define CHECK(cond)                                                                                                                                            \
+   do {                                                                                                                                                        \
+      if (!(cond)) {                                                                                                                                           \
+         fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                                                                              \
+         test_failures++;                                                                                                                                      \
+      }                                                                                                                                                        \
+   } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                                                                             \
+   do {                                                                                                                                                        \
+      const long long actual_ = (actual);                                                                                                                      \
+      const long long expected_ = (expected);                                                                                                                  \
+      if (actual_ != expected_) {                                                                                                                              \
+         fprintf(stderr, "%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, actual_, expected_);                                               \
+         test_failures++;                                                                                                                                      \
+      }                                                                                                                                                        \
+   } while (0)
+
+#define TEST_RESULT() (test_failures ? (fprintf(stderr, "%d check(s) failed\n", test_failures), 1) : 0)
+
+#endif // _EBTN_TEST_H
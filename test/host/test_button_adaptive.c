@@ -0,0 +1,71 @@
+/*
+ * Adaptive polling rate: after the quiet time buttons are polled at the idle interval, where a tap is only seen if it
+ * spans an idle poll. The first poll that sees it returns to the normal interval, so the release and click are timed as usual.
+ */
+#include <button.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define PIN 4
+#define POLL_US (CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000)
+#define IDLE_POLL_US (CONFIG_EBTN_POLLING_IDLE_INTERVAL_MS_BTN * 1000)
+
+static QueueHandle_t queue;
+
+static int next_event() {
+   button_event_t e;
+   return xQueueReceive(queue, &e, 0) ? (int)e.type : -1;
+}
+
+static uint32_t period_us() {
+   ebtn_rate_info_t info;
+   button_get_rate_info(&info);
+   return info.period_us;
+}
+
+// advances to just after the next poll
+static void sync_poll() {
+   const uint32_t calls = mock_hal_timer_calls;
+   while (mock_hal_timer_calls == calls)
+      mock_hal_advance(100);
+}
+
+int main() {
+   mock_hal_reset();
+   queue = xQueueCreate(16, sizeof(button_event_t));
+
+   button_t btn = {.pin = PIN};
+   CHECK_EQ(button_init(queue), ESP_OK);
+   CHECK_EQ(button_add(&btn), ESP_OK);
+
+   mock_hal_advance((CONFIG_EBTN_ADAPTIVE_QUIET_MS + 100) * 1000);
+   CHECK_EQ(period_us(), IDLE_POLL_US);
+
+   // a tap between two idle polls is missed
+   sync_poll();
+   mock_hal_level[PIN] = 1;
+   mock_hal_advance(IDLE_POLL_US / 2);
+   mock_hal_level[PIN] = 0;
+   mock_hal_advance(IDLE_POLL_US * 2);
+   CHECK_EQ(next_event(), -1);
+   CHECK_EQ(period_us(), IDLE_POLL_US);
+
+   // a tap spanning an idle poll is seen, and polling returns to the normal interval to time it
+   sync_poll();
+   mock_hal_level[PIN] = 1;
+   mock_hal_advance(IDLE_POLL_US + 1000);
+   CHECK_EQ(next_event(), BUTTON_PRESSED);
+   CHECK_EQ(period_us(), POLL_US);
+   mock_hal_level[PIN] = 0;
+   mock_hal_advance((CONFIG_EBTN_CLICK_MAX_MS + 50) * 1000);
+   CHECK_EQ(next_event(), BUTTON_RELEASED);
+   CHECK_EQ(next_event(), BUTTON_CLICKED);
+   CHECK_EQ(next_event(), -1);
+
+   CHECK_EQ(button_remove(&btn), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+   vQueueDelete(queue);
+
+   return TEST_RESULT();
+}
@@ -0,0 +1,124 @@
+/*
+ * Idle shutdown of the button polling timer: stops once every button is released and settled, and a GPIO edge restarts it
+ * without losing the press. Taps while idle are seen if they last one polling interval past the edge, from GPIO edges or
+ * button_wake() for a custom poll_state_callback.
+ */
+#include <button.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define PIN 4
+#define POLL_US (CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000)
+
+static QueueHandle_t queue;
+
+static uint8_t custom_level;
+
+static uint8_t custom_read(gpio_num_t pin) {
+   return custom_level;
+}
+
+static int next_event() {
+   button_event_t e;
+   return xQueueReceive(queue, &e, 0) ? (int)e.type : -1;
+}
+
+int main() {
+   mock_hal_reset();
+   mock_hal_now_us = 1000000;
+   queue = xQueueCreate(16, sizeof(button_event_t));
+
+   button_t btn = {.pin = PIN};
+   CHECK_EQ(button_init(queue), ESP_OK);
+   CHECK_EQ(button_add(&btn), ESP_OK);
+
+   // released, the first poll finds nothing to do and stops the timer
+   mock_hal_advance(50000);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+   const uint32_t calls = mock_hal_timer_calls;
+
+   // hours of idle cost no polls
+   mock_hal_advance(3600LL * 1000000);
+   CHECK_EQ(mock_hal_timer_calls, calls);
+
+   // the press edge restarts polling, the press is seen by the next poll
+   mock_hal_gpio_edge(PIN, 1);
+   CHECK_EQ(mock_hal_timers_running(), 1);
+   mock_hal_advance(CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000);
+   CHECK_EQ(next_event(), BUTTON_PRESSED);
+
+   // held through a long press, polling keeps running
+   mock_hal_advance((CONFIG_EBTN_LONG_PRESS_MIN_MS + 50) * 1000);
+   CHECK_EQ(next_event(), BUTTON_PRESSED_LONG);
+   CHECK_EQ(mock_hal_timers_running(), 1);
+
+   // released after a long press, which isn't also a click, nothing pending so the timer stops again
+   mock_hal_gpio_edge(PIN, 0);
+   mock_hal_advance(50000);
+   CHECK_EQ(next_event(), BUTTON_RELEASED);
+   CHECK_EQ(next_event(), -1);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+
+   // a tap keeps polling until the click window has passed, then the click is sent and the timer stops
+   mock_hal_gpio_edge(PIN, 1);
+   mock_hal_advance(50000);
+   mock_hal_gpio_edge(PIN, 0);
+   mock_hal_advance(50000);
+   CHECK_EQ(mock_hal_timers_running(), 1);
+   mock_hal_advance((CONFIG_EBTN_CLICK_MAX_MS + 50) * 1000);
+   CHECK_EQ(next_event(), BUTTON_PRESSED);
+   CHECK_EQ(next_event(), BUTTON_RELEASED);
+   CHECK_EQ(next_event(), BUTTON_CLICKED);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+   CHECK_EQ(next_event(), -1);
+
+   // the wake edge is sampled one polling interval later, a shorter tap is over by then
+   mock_hal_gpio_edge(PIN, 1);
+   mock_hal_advance(POLL_US / 2);
+   mock_hal_gpio_edge(PIN, 0);
+   mock_hal_advance(50000);
+   CHECK_EQ(next_event(), -1);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+
+   // a tap just longer than one polling interval is seen, and still clicks
+   mock_hal_gpio_edge(PIN, 1);
+   mock_hal_advance(POLL_US + 1000);
+   mock_hal_gpio_edge(PIN, 0);
+   mock_hal_advance((CONFIG_EBTN_CLICK_MAX_MS + 50) * 1000);
+   CHECK_EQ(next_event(), BUTTON_PRESSED);
+   CHECK_EQ(next_event(), BUTTON_RELEASED);
+   CHECK_EQ(next_event(), BUTTON_CLICKED);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+
+   CHECK_EQ(button_remove(&btn), ESP_OK);
+
+   // a custom poll_state_callback has no edge interrupt, taps while idle are missed unless button_wake() is called
+   button_t custom = {.pin = PIN, .poll_state_callback = custom_read};
+   CHECK_EQ(button_add(&custom), ESP_OK);
+   mock_hal_advance(50000);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+
+   custom_level = 1;
+   mock_hal_advance(100000);
+   custom_level = 0;
+   mock_hal_advance(50000);
+   CHECK_EQ(next_event(), -1);
+
+   custom_level = 1;
+   button_wake();
+   mock_hal_advance(POLL_US + 1000);
+   custom_level = 0;
+   button_wake();
+   mock_hal_advance((CONFIG_EBTN_CLICK_MAX_MS + 50) * 1000);
+   CHECK_EQ(next_event(), BUTTON_PRESSED);
+   CHECK_EQ(next_event(), BUTTON_RELEASED);
+   CHECK_EQ(next_event(), BUTTON_CLICKED);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+
+   CHECK_EQ(button_remove(&custom), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+   vQueueDelete(queue);
+
+   return TEST_RESULT();
+}
@@ -0,0 +1,175 @@
+/*
+ * Resistor ladder fed with voltage traces, one sample per poll: classification at the band edges, noise around a midpoint
+ * with and without hysteresis, and presses/releases decoded end to end, including a release sweeping through another band.
+ */
+#include <string.h>
+
+#include <button_ladder.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define BUTTONS 4
+#define IDLE_MV 3300
+#define HYSTERESIS_MV 50
+
+static const uint16_t LEVELS[BUTTONS] = {0, 800, 1600, 2400}; // mV
+
+// Voltage trace, one sample per call, the last sample is held once the trace ends
+static const uint16_t* trace;
+static size_t trace_len;
+static size_t trace_pos;
+
+static uint16_t sample(button_ladder_t* ladder) {
+   const uint16_t mv = trace[trace_pos < trace_len ? trace_pos : trace_len - 1];
+   trace_pos++;
+   return mv;
+}
+
+static void play(const uint16_t* samples, size_t len) {
+   trace = samples;
+   trace_len = len;
+   trace_pos = 0;
+}
+
+#define PLAY(...)                                                                                                                                              \
+   do {                                                                                                                                                        \
+      static const uint16_t samples_[] = {__VA_ARGS__};                                                                                                        \
+      play(samples_, sizeof(samples_) / sizeof(samples_[0]));                                                                                                  \
+   } while (0)
+
+static button_ladder_t ladder;
+
+static void ladder_init(uint16_t hysteresis) {
+   ladder = (button_ladder_t){.count = BUTTONS, .levels = LEVELS, .idle_level = IDLE_MV, .hysteresis = hysteresis, .sample_callback = sample};
+   CHECK_EQ(button_ladder_init(&ladder), ESP_OK);
+}
+
+// classifies the next sample of the trace, returns the pressed button or -1
+static int classify() {
+   const ebtn_mask_t mask = ladder.port.poll_port_callback(ladder.port.port, ladder.port.ctx);
+   return mask ? __builtin_ctzll(mask) : -1;
+}
+
+static void test_band_edges() {
+   ladder_init(HYSTERESIS_MV);
+
+   // released to button 3: the midpoint is 2850, switching needs 50 mV past it
+   PLAY(2801, 2800, 2799);
+   CHECK_EQ(classify(), -1);
+   CHECK_EQ(classify(), -1); // exactly at the hysteresis
+   CHECK_EQ(classify(), 3);
+
+   // button 1 to 2 and back: the midpoint is 1200
+   PLAY(800, 1249, 1250, 1251, 1151, 1150, 1149);
+   CHECK_EQ(classify(), 1);
+   CHECK_EQ(classify(), 1);
+   CHECK_EQ(classify(), 1);
+   CHECK_EQ(classify(), 2);
+   CHECK_EQ(classify(), 2);
+   CHECK_EQ(classify(), 2);
+   CHECK_EQ(classify(), 1);
+
+   // a sample far into another band switches directly, without passing the bands in between
+   PLAY(10, 3300);
+   CHECK_EQ(classify(), 0);
+   CHECK_EQ(classify(), -1);
+
+   // out of range samples clamp to the outermost bands
+   PLAY(4095, 0);
+   CHECK_EQ(classify(), -1);
+   CHECK_EQ(classify(), 0);
+}
+
+// counts classification changes of noise around the 1200 mV midpoint
+static int noise_changes(uint16_t hysteresis) {
+   ladder_init(hysteresis);
+   PLAY(800, 1180, 1230, 1170, 1240, 1160, 1220, 1190, 1235, 1165, 1210);
+
+   int changes = 0;
+   int prev = classify();
+   for (int i = 1; i < 11; i++) {
+      const int pressed = classify();
+      changes += pressed != prev;
+      prev = pressed;
+   }
+   return changes;
+}
+
+static QueueHandle_t queue;
+static button_t buttons[BUTTONS];
+
+// events since the last call, as "<button><type>" separated by spaces
+static const char* events() {
+   static const char TYPES[] = {[BUTTON_RELEASED] = 'R', [BUTTON_PRESSED] = 'P', [BUTTON_PRESSED_LONG] = 'L', [BUTTON_CLICKED] = 'C'};
+   static char log[128];
+   size_t n = 0;
+
+   button_event_t e;
+   while (xQueueReceive(queue, &e, 0) && n + 4 < sizeof(log))
+      n += snprintf(log + n, sizeof(log) - n, n ? " %d%c" : "%d%c", (int)(e.sender - buttons), TYPES[e.type]);
+   log[n] = '\0';
+   return log;
+}
+
+#define CHECK_EVENTS(expected)                                                                                                                                 \
+   do {                                                                                                                                                        \
+      const char* log_ = events();                                                                                                                             \
+      if (strcmp(log_, expected)) {                                                                                                                            \
+         fprintf(stderr, "%s:%d: events \"%s\", expected \"%s\"\n", __FILE__, __LINE__, log_, expected);                                                      \
+         test_failures++;                                                                                                                                      \
+      }                                                                                                                                                        \
+   } while (0)
+
+#define POLL_US (CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000)
+
+static void test_end_to_end() {
+   mock_hal_reset();
+   queue = xQueueCreate(16, sizeof(button_event_t));
+
+   ladder_init(HYSTERESIS_MV);
+   ladder.port.debounce = true; // releases sweep through the bands above, debouncing hides the samples in between
+   PLAY(IDLE_MV);
+
+   CHECK_EQ(button_init(queue), ESP_OK);
+   for (int i = 0; i < BUTTONS; i++) {
+      buttons[i] = (button_t){.port = &ladder.port, .pin = i};
+      CHECK_EQ(button_add(&buttons[i]), ESP_OK);
+   }
+   mock_hal_advance(50 * 1000);
+   CHECK_EVENTS("");
+
+   // button 2 held with noise around its level, released through the button 3 band in two samples
+   PLAY(3000, 2000, 1620, 1575, 1650, 1560, 1610, 1590, 1640, 1580, 1600, 1615, 2300, 2500, 3100, 3290, 3300);
+   mock_hal_advance(12 * POLL_US);
+   CHECK_EVENTS("2P");
+   mock_hal_advance(5 * POLL_US);
+   CHECK_EVENTS("2R");
+   mock_hal_advance(300 * 1000);
+   CHECK_EVENTS("2C");
+
+   // held through a long press
+   PLAY(800);
+   mock_hal_advance((CONFIG_EBTN_LONG_PRESS_MIN_MS + 100) * 1000);
+   CHECK_EVENTS("1P 1L");
+   PLAY(IDLE_MV);
+   mock_hal_advance(100 * 1000);
+   CHECK_EVENTS("1R");
+
+   for (int i = 0; i < BUTTONS; i++)
+      CHECK_EQ(button_remove(&buttons[i]), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+   vQueueDelete(queue);
+}
+
+int main() {
+   test_band_edges();
+
+   // noise of +-40 mV around a midpoint toggles without hysteresis, and not with 50 mV
+   CHECK(noise_changes(0) > 5);
+   CHECK_EQ(noise_changes(HYSTERESIS_MV), 0);
+
+   test_end_to_end();
+
+   return TEST_RESULT();
+}
@@ -0,0 +1,267 @@
+/*
+ * Key matrix scanned against a simulated 3x3 matrix on the builtin GPIO callbacks: presses, ghosting with and without
+ * diodes, and the scan rate. Also built with CONFIG_EBTN_BTN_IDLE_SHUTDOWN, where the matrix needs its own scan timer to
+ * wake the idle button poll, and must stop waking it once its last key is removed.
+ */
+#include <string.h>
+
+#include <button_matrix.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define ROWS 3
+#define COLS 3
+#define KEYS (ROWS * COLS)
+
+static const gpio_num_t ROW_PINS[ROWS] = {10, 11, 12};
+static const gpio_num_t COL_PINS[COLS] = {20, 21, 22};
+
+// Simulated matrix, active low: a selected row is driven low, columns are pulled up and read low when connected to it
+static bool pressed[ROWS][COLS];
+static bool selected[ROWS];
+static bool diodes;
+static uint32_t selects;
+
+static void write_pin(gpio_num_t pin, uint8_t level) {
+   for (int r = 0; r < ROWS; r++) {
+      if (pin == ROW_PINS[r]) {
+         selected[r] = !level;
+         selects += !level;
+      }
+   }
+}
+
+// Without diodes, current also flows backwards through pressed keys into other rows and on to their columns (ghosting)
+static bool connected(int col) {
+   bool rows[ROWS], cols[COLS] = {0};
+   memcpy(rows, selected, sizeof(rows));
+
+   for (bool changed = true; changed;) {
+      changed = false;
+      for (int r = 0; r < ROWS; r++) {
+         for (int c = 0; c < COLS; c++) {
+            if (!pressed[r][c])
+               continue;
+            if (rows[r] && !cols[c])
+               changed = cols[c] = true;
+            if (!diodes && cols[c] && !rows[r])
+               changed = rows[r] = true;
+         }
+      }
+   }
+   return cols[col];
+}
+
+static uint8_t read_pin(gpio_num_t pin) {
+   for (int c = 0; c < COLS; c++) {
+      if (pin == COL_PINS[c])
+         return !connected(c);
+   }
+   return mock_hal_level[pin];
+}
+
+static QueueHandle_t queue;
+static button_matrix_t matrix;
+static button_t keys[KEYS];
+
+// events since the last call, as "<key><type>" separated by spaces, e.g. "0P 1P" for keys 0 and 1 pressed
+static const char* events() {
+   static const char TYPES[] = {[BUTTON_RELEASED] = 'R', [BUTTON_PRESSED] = 'P', [BUTTON_PRESSED_LONG] = 'L', [BUTTON_CLICKED] = 'C'};
+   static char log[128];
+   size_t n = 0;
+
+   button_event_t e;
+   while (xQueueReceive(queue, &e, 0) && n + 4 < sizeof(log))
+      n += snprintf(log + n, sizeof(log) - n, n ? " %d%c" : "%d%c", (int)(e.sender - keys), TYPES[e.type]);
+   log[n] = '\0';
+   return log;
+}
+
+#define CHECK_EVENTS(expected)                                                                                                                                 \
+   do {                                                                                                                                                        \
+      const char* log_ = events();                                                                                                                             \
+      if (strcmp(log_, expected)) {                                                                                                                            \
+         fprintf(stderr, "%s:%d: events \"%s\", expected \"%s\"\n", __FILE__, __LINE__, log_, expected);                                                      \
+         test_failures++;                                                                                                                                      \
+      }                                                                                                                                                        \
+   } while (0)
+
+static void setup(bool with_diodes, uint32_t scan_interval_us) {
+   mock_hal_reset();
+   mock_hal_set_gpio(read_pin, write_pin);
+   memset(pressed, 0, sizeof(pressed));
+   memset(selected, 0, sizeof(selected));
+   diodes = with_diodes;
+
+   matrix = (button_matrix_t){
+       .rows = ROWS,
+       .cols = COLS,
+       .row_pins = ROW_PINS,
+       .col_pins = COL_PINS,
+       .internal_pull = true,
+       .active_low = true,
+       .diodes = with_diodes,
+       .scan_interval_us = scan_interval_us,
+   };
+
+   CHECK_EQ(button_init(queue), ESP_OK);
+   CHECK_EQ(button_matrix_init(&matrix), ESP_OK);
+   for (int k = 0; k < KEYS; k++) {
+      keys[k] = (button_t){.port = &matrix.port, .pin = button_matrix_key(&matrix, k / COLS, k % COLS)};
+      CHECK_EQ(button_add(&keys[k]), ESP_OK);
+   }
+   mock_hal_advance(50000);
+   selects = 0;
+}
+
+static void teardown() {
+   for (int k = 0; k < KEYS; k++)
+      CHECK_EQ(button_remove(&keys[k]), ESP_OK);
+   CHECK_EQ(button_matrix_free(&matrix), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+}
+
+static void test_press(uint32_t scan_interval_us) {
+   setup(false, scan_interval_us);
+
+   pressed[1][2] = true;
+   mock_hal_advance(50000);
+   CHECK_EVENTS("5P");
+
+   pressed[1][2] = false;
+   mock_hal_advance(50000);
+   CHECK_EVENTS("5R");
+   mock_hal_advance(300000);
+   CHECK_EVENTS("5C");
+
+   teardown();
+}
+
+#if !CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+static void test_ghosting() {
+   setup(false, 0);
+
+   pressed[0][0] = pressed[0][1] = true;
+   mock_hal_advance(50000);
+   CHECK_EVENTS("0P 1P");
+
+   // the third corner of a rectangle also closes the fourth (key 4), so both rows keep their previous state
+   pressed[1][0] = true;
+   mock_hal_advance(50000);
+   CHECK_EVENTS("");
+   CHECK(matrix.internal.ghosts > 0);
+
+   // no longer ambiguous once a corner is released. Keys share click group 0, so only the last pressed key clicks.
+   pressed[0][1] = false;
+   mock_hal_advance(50000);
+   CHECK_EVENTS("1R 3P");
+   mock_hal_advance(300000);
+   CHECK_EVENTS("");
+
+   pressed[0][0] = pressed[1][0] = false;
+   mock_hal_advance(50000);
+   CHECK_EVENTS("0R 3R 3C");
+   mock_hal_advance(300000);
+   CHECK_EVENTS("");
+
+   teardown();
+}
+
+static void test_diodes() {
+   setup(true, 0);
+
+   pressed[0][0] = pressed[0][1] = pressed[1][0] = true;
+   mock_hal_advance(50000);
+   CHECK_EVENTS("0P 1P 3P");
+   CHECK_EQ(matrix.internal.ghosts, 0);
+
+   pressed[0][0] = pressed[0][1] = pressed[1][0] = false;
+   mock_hal_advance(50000);
+   CHECK_EVENTS("0R 1R 3R");
+   mock_hal_advance(300000);
+   CHECK_EVENTS("3C"); // last pressed of the click group
+
+   teardown();
+}
+#endif
+
+// scans at scan_interval_us if set, otherwise once per button poll, selecting each row once per scan
+static void test_scan_rate(uint32_t scan_interval_us) {
+   setup(true, scan_interval_us);
+
+   mock_hal_advance(100000);
+   const uint32_t scans = 100000 / (scan_interval_us ? scan_interval_us : CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000);
+   CHECK_EQ(selects, scans * ROWS);
+
+   teardown();
+}
+
+// a scan after the last key left its engine (here deleted along with it) finds no engine to wake
+static void test_remove_last() {
+   setup(false, 2500);
+
+   button_engine_t* engine;
+   const button_engine_config_t config = {.queue = queue};
+   CHECK_EQ(button_engine_create(&config, &engine), ESP_OK);
+   button_t key = {.port = &matrix.port, .pin = button_matrix_key(&matrix, 0, 0)};
+   for (int k = 0; k < KEYS; k++)
+      CHECK_EQ(button_remove(&keys[k]), ESP_OK);
+   CHECK_EQ(button_engine_add(engine, &key), ESP_OK);
+   CHECK(matrix.port.internal.engine == engine);
+   mock_hal_advance(50000);
+
+   CHECK_EQ(button_engine_remove(engine, &key), ESP_OK);
+   CHECK(matrix.port.internal.engine == NULL);
+   CHECK_EQ(button_engine_delete(engine), ESP_OK);
+
+   pressed[0][0] = true;
+   mock_hal_advance(50000);
+   CHECK_EVENTS("");
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   CHECK_EQ(mock_hal_timers_running(), 1); // only the scan timer, the default engine stays idle
+#endif
+
+   CHECK_EQ(button_matrix_free(&matrix), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+}
+
+int main() {
+   queue = xQueueCreate(16, sizeof(button_event_t));
+
+#if CONFIG_EBTN_BTN_IDLE_SHUTDOWN
+   // scanning from the button poll would stop with it
+   button_matrix_t invalid = {.rows = ROWS, .cols = COLS, .row_pins = ROW_PINS, .col_pins = COL_PINS, .active_low = true};
+   CHECK_EQ(button_matrix_init(&invalid), ESP_ERR_INVALID_ARG);
+
+   test_press(2500);
+   test_scan_rate(2500);
+
+   // the button poll stops while nothing is pressed, a press seen by the scan timer wakes it
+   setup(false, 2500);
+   mock_hal_advance(1000000);
+   CHECK_EQ(mock_hal_timers_running(), 1); // only the scan timer
+   pressed[2][0] = true;
+   mock_hal_advance(2500 + CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000);
+   CHECK_EVENTS("6P");
+   CHECK_EQ(mock_hal_timers_running(), 2);
+   pressed[2][0] = false;
+   mock_hal_advance(1000000);
+   CHECK_EVENTS("6R 6C");
+   CHECK_EQ(mock_hal_timers_running(), 1);
+   teardown();
+
+   test_remove_last();
+#else
+   test_press(0);
+   test_press(2500);
+   test_ghosting();
+   test_diodes();
+   test_scan_rate(0);
+   test_scan_rate(2500);
+   test_remove_last();
+#endif
+
+   vQueueDelete(queue);
+   return TEST_RESULT();
+}
@@ -0,0 +1,111 @@
+/*
+ * Compact layout: events carry the id instead of the sender, so adding a button or encoder without an id, or with one
+ * already used in its engine (directly polled or on a port), fails. Events of buttons pressed together keep their ids.
+ */
+#include <encoder.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+static ebtn_mask_t port_mask;
+
+static ebtn_mask_t poll_port(uint8_t port, void* ctx) {
+   return port_mask;
+}
+
+static void test_buttons() {
+   QueueHandle_t queue = xQueueCreate(8, sizeof(button_event_t));
+   button_port_t port = {.poll_port_callback = poll_port};
+   button_t no_id = {.pin = 4};
+   button_t btn = {.id = 1, .pin = 4};
+   button_t same_id = {.id = 1, .pin = 5};
+   button_t port_same_id = {.id = 1, .port = &port, .pin = 0};
+   button_t port_btn = {.id = 2, .port = &port, .pin = 0};
+   button_t port_btn_same_id = {.id = 2, .pin = 6};
+
+   CHECK_EQ(button_init(queue), ESP_OK);
+   CHECK_EQ(button_add(&no_id), ESP_ERR_INVALID_ARG);
+   CHECK_EQ(button_add(&btn), ESP_OK);
+   CHECK_EQ(button_add(&same_id), ESP_ERR_INVALID_ARG);
+   CHECK_EQ(button_add(&port_same_id), ESP_ERR_INVALID_ARG);
+   CHECK_EQ(button_add(&port_btn), ESP_OK);
+   CHECK_EQ(button_add(&port_btn_same_id), ESP_ERR_INVALID_ARG);
+
+   // pressed together, events tell them apart
+   mock_hal_level[4] = 1;
+   port_mask = 1;
+   mock_hal_advance(50000);
+
+   button_event_t e1, e2;
+   CHECK(xQueueReceive(queue, &e1, 0) && e1.type == BUTTON_PRESSED);
+   CHECK(xQueueReceive(queue, &e2, 0) && e2.type == BUTTON_PRESSED);
+   CHECK_EQ(button_event_id(&e1) ^ button_event_id(&e2), 1 ^ 2);
+   mock_hal_level[4] = 0;
+   port_mask = 0;
+   mock_hal_advance(500000);
+
+   // ids are free again once removed
+   CHECK_EQ(button_remove(&btn), ESP_OK);
+   CHECK_EQ(button_add(&same_id), ESP_OK);
+   CHECK_EQ(button_remove(&port_btn), ESP_OK);
+   CHECK_EQ(button_add(&port_btn_same_id), ESP_OK);
+
+   // ids only need to be unique within an engine
+   button_engine_t* engine;
+   const button_engine_config_t config = {.queue = queue};
+   CHECK_EQ(button_engine_create(&config, &engine), ESP_OK);
+   CHECK_EQ(button_engine_add(engine, &btn), ESP_OK);
+   CHECK_EQ(button_engine_remove(engine, &btn), ESP_OK);
+   CHECK_EQ(button_engine_delete(engine), ESP_OK);
+
+   CHECK_EQ(button_remove(&same_id), ESP_OK);
+   CHECK_EQ(button_remove(&port_btn_same_id), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+   vQueueDelete(queue);
+}
+
+static void poll_encoder_port(uint8_t port, void* ctx, ebtn_mask_t* a, ebtn_mask_t* b) {
+   *a = *b = 0;
+}
+
+static void test_encoders() {
+   QueueHandle_t queue = xQueueCreate(8, sizeof(rotary_encoder_event_t));
+   rotary_encoder_port_t port = {.poll_port_callback = poll_encoder_port};
+   rotary_encoder_t no_id = {.pin_a = 10, .pin_b = 11};
+   rotary_encoder_t enc = {.id = 1, .pin_a = 10, .pin_b = 11};
+   rotary_encoder_t same_id = {.id = 1, .pin_a = 12, .pin_b = 13};
+   rotary_encoder_t port_same_id = {.id = 1, .port = &port, .pin_a = 0};
+   rotary_encoder_t port_enc = {.id = 2, .port = &port, .pin_a = 0};
+
+   CHECK_EQ(rotary_encoder_init(queue), ESP_OK);
+   CHECK_EQ(rotary_encoder_add(&no_id), ESP_ERR_INVALID_ARG);
+   CHECK_EQ(rotary_encoder_add(&enc), ESP_OK);
+   CHECK_EQ(rotary_encoder_add(&same_id), ESP_ERR_INVALID_ARG);
+   CHECK_EQ(rotary_encoder_add(&port_same_id), ESP_ERR_INVALID_ARG);
+   CHECK_EQ(rotary_encoder_add(&port_enc), ESP_OK);
+
+   // one clockwise step
+   static const uint8_t cycle[4] = {0b01, 0b11, 0b10, 0b00};
+   for (int i = 0; i < 4; i++) {
+      mock_hal_level[10] = cycle[i] >> 1;
+      mock_hal_level[11] = cycle[i] & 1;
+      mock_hal_advance(CONFIG_EBTN_POLLING_INTERVAL_US_ENC);
+   }
+   rotary_encoder_event_t e;
+   CHECK(xQueueReceive(queue, &e, 0) && e.dir == ROT_CLOCKWISE);
+   CHECK_EQ(rotary_encoder_event_id(&e), 1);
+
+   CHECK_EQ(rotary_encoder_remove(&enc), ESP_OK);
+   CHECK_EQ(rotary_encoder_remove(&port_enc), ESP_OK);
+   CHECK_EQ(rotary_encoder_free(), ESP_OK);
+   vQueueDelete(queue);
+}
+
+int main() {
+   mock_hal_reset();
+
+   test_buttons();
+   test_encoders();
+
+   return TEST_RESULT();
+}
@@ -0,0 +1,69 @@
+/*
+ * Coalesced encoder events: velocity and acceleration from the time since the previous event, also after idling for
+ * longer than a 32-bit microsecond counter can hold.
+ */
+#include <encoder.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define PIN_A 2
+#define PIN_B 3
+#define POLL_US CONFIG_EBTN_POLLING_INTERVAL_US_ENC
+
+static rotary_encoder_event_t last;
+static int events;
+
+static void on_event(const rotary_encoder_event_t* e) {
+   last = *e;
+   events++;
+}
+
+// one clockwise cycle from rest, the step is sent at 11
+static void turn_cw() {
+   static const uint8_t cycle[4] = {0b01, 0b11, 0b10, 0b00};
+   for (int i = 0; i < 4; i++) {
+      mock_hal_level[PIN_A] = cycle[i] >> 1;
+      mock_hal_level[PIN_B] = cycle[i] & 1;
+      mock_hal_advance(POLL_US);
+   }
+}
+
+int main() {
+   mock_hal_reset();
+   mock_hal_now_us = 1000000;
+   QueueHandle_t queue = xQueueCreate(1, sizeof(rotary_encoder_event_t));
+
+   rotary_encoder_t enc = {.pin_a = PIN_A, .pin_b = PIN_B};
+   CHECK_EQ(rotary_encoder_init(queue), ESP_OK);
+   rotary_encoder_set_event_callback(on_event);
+   CHECK_EQ(rotary_encoder_add(&enc), ESP_OK);
+
+   // a step a second after the previous event is slow, no acceleration
+   mock_hal_advance(1000000 - 2 * POLL_US);
+   turn_cw();
+   CHECK_EQ(events, 1);
+   CHECK_EQ(last.delta, 1);
+   CHECK_EQ(last.velocity, 1);
+   CHECK_EQ(last.accel_delta, 1);
+
+   // a step 10 ms later is fast, accelerated by the maximum factor
+   mock_hal_advance(10000 - 4 * POLL_US);
+   turn_cw();
+   CHECK_EQ(events, 2);
+   CHECK_EQ(last.velocity, 100);
+   CHECK_EQ(last.accel_delta, CONFIG_EBTN_ENC_ACCEL_MAX_FACTOR);
+
+   // idle for 2^32 us + 10 ms, a step after that is still slow
+   mock_hal_advance((1LL << 32) + 10000 - 4 * POLL_US);
+   turn_cw();
+   CHECK_EQ(events, 3);
+   CHECK_EQ(last.velocity, 0);
+   CHECK_EQ(last.accel_delta, 1);
+
+   CHECK_EQ(rotary_encoder_remove(&enc), ESP_OK);
+   CHECK_EQ(rotary_encoder_free(), ESP_OK);
+   vQueueDelete(queue);
+
+   return TEST_RESULT();
+}
@@ -0,0 +1,102 @@
+/*
+ * Recorded A/B traces replayed through each step mode, decoded per encoder through poll_state_callback and by the
+ * bit-sliced port decoder. Both must emit the expected steps, in order.
+ */
+#include <string.h>
+
+#include <encoder.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define PORT_BIT 5 // not bit 0, so shifts are exercised
+
+typedef struct {
+   const char* name;
+   const char* samples; // A/B per poll, starting at rest
+   const char* steps[3]; // expected events per step mode, + clockwise and - counterclockwise
+} trace_t;
+
+static const trace_t traces[] = {
+    {"clockwise", "00 01 11 10 00 01 11 10 00", {"++", "++++", "++++++++"}},
+    {"counterclockwise", "00 10 11 01 00 10 11 01 00", {"--", "----", "--------"}},
+    {"bounce on B", "00 01 00 01 11 10 00", {"+", "++", "+-++++"}},
+    {"reversal at 11", "00 01 11 01 00", {"+", "+-", "++--"}},
+    {"reversal at 01", "00 01 00 10 11 01 00", {"-", "--", "+-----"}},
+    {"wiggle at rest", "00 01 00 10 00", {"", "", "+--+"}},
+    {"skipped state from rest", "00 11 00 01 11", {"+", "+", "++"}},
+    {"skipped state mid cycle", "00 01 10 11", {"", "", "+-"}},
+    {"repeated samples", "00 00 01 01 11 11 10 10 00 00", {"+", "++", "++++"}},
+};
+
+static const char* MODE_NAMES[] = {"full", "half", "quarter"};
+
+static uint8_t sample; // A << 1 | B of the current poll
+static bool inverted;  // levels on the wire are inverted, for active low encoders
+
+static char events[32];
+static size_t event_count;
+
+static uint8_t read_pin(gpio_num_t pin) {
+   return ((pin ? sample : sample >> 1) & 1) ^ inverted;
+}
+
+static void read_port(uint8_t port, void* ctx, ebtn_mask_t* a, ebtn_mask_t* b) {
+   *a = (ebtn_mask_t)(((sample >> 1) & 1) ^ inverted) << PORT_BIT;
+   *b = (ebtn_mask_t)((sample & 1) ^ inverted) << PORT_BIT;
+}
+
+static void on_event(const rotary_encoder_event_t* e) {
+   if (event_count < sizeof(events) - 1)
+      events[event_count++] = e->dir == ROT_CLOCKWISE ? '+' : '-';
+}
+
+static void replay(const trace_t* trace, rotary_encoder_step_mode_t mode, bool on_port, bool active_low) {
+   rotary_encoder_port_t port = {.poll_port_callback = read_port};
+   rotary_encoder_t enc = {
+       .pin_a = on_port ? PORT_BIT : 0,
+       .pin_b = on_port ? PORT_BIT : 1,
+       .poll_state_callback = read_pin,
+       .port = on_port ? &port : NULL,
+       .active_low = active_low,
+       .step_mode = mode,
+   };
+
+   memset(events, 0, sizeof(events));
+   event_count = 0;
+   inverted = active_low;
+   sample = 0;
+
+   CHECK_EQ(rotary_encoder_add(&enc), ESP_OK);
+   for (const char* s = trace->samples; *s; s += s[2] ? 3 : 2) {
+      sample = (s[0] - '0') << 1 | (s[1] - '0');
+      mock_hal_advance(CONFIG_EBTN_POLLING_INTERVAL_US_ENC);
+   }
+   CHECK_EQ(rotary_encoder_remove(&enc), ESP_OK);
+
+   if (strcmp(events, trace->steps[mode])) {
+      fprintf(stderr, "%s, %s step%s%s: got \"%s\", expected \"%s\"\n", trace->name, MODE_NAMES[mode], on_port ? ", port" : "",
+              active_low ? ", active low" : "", events, trace->steps[mode]);
+      test_failures++;
+   }
+}
+
+int main() {
+   mock_hal_reset();
+   QueueHandle_t queue = xQueueCreate(1, sizeof(rotary_encoder_event_t));
+   CHECK_EQ(rotary_encoder_init(queue), ESP_OK);
+   rotary_encoder_set_event_callback(on_event);
+
+   for (size_t t = 0; t < sizeof(traces) / sizeof(traces[0]); t++) {
+      for (int mode = ROT_STEP_FULL; mode <= ROT_STEP_QUARTER; mode++) {
+         replay(&traces[t], mode, false, false);
+         replay(&traces[t], mode, true, false);
+         replay(&traces[t], mode, false, true);
+         replay(&traces[t], mode, true, true);
+      }
+   }
+
+   CHECK_EQ(rotary_encoder_free(), ESP_OK);
+   vQueueDelete(queue);
+   return TEST_RESULT();
+}
@@ -0,0 +1,85 @@
+/*
+ * Encoders decoded from GPIO edge interrupts: CW and CCW edge sequences replayed through the interrupt handler, and edges
+ * ignored by the glitch filter, which the next poll picks up by sampling the pins again.
+ */
+#include <encoder.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define PIN_A 2
+#define PIN_B 3
+#define POLL_US CONFIG_EBTN_POLLING_INTERVAL_US_ENC
+#define GLITCH_US CONFIG_EBTN_ENC_ISR_GLITCH_US
+
+static QueueHandle_t queue;
+
+static int next_dir() {
+   rotary_encoder_event_t e;
+   return xQueueReceive(queue, &e, 0) ? (int)e.dir : 0;
+}
+
+// replays A/B samples as edges on the pin that changed, gap apart
+static void replay(const uint8_t* samples, int count, int64_t gap_us) {
+   for (int i = 0; i < count; i++) {
+      if ((samples[i] >> 1) != mock_hal_level[PIN_A])
+         mock_hal_gpio_edge(PIN_A, samples[i] >> 1);
+      if ((samples[i] & 1) != mock_hal_level[PIN_B])
+         mock_hal_gpio_edge(PIN_B, samples[i] & 1);
+      mock_hal_advance(gap_us);
+   }
+}
+
+static const uint8_t CW[4] = {0b01, 0b11, 0b10, 0b00};
+static const uint8_t CCW[4] = {0b10, 0b11, 0b01, 0b00};
+
+int main() {
+   mock_hal_reset();
+   queue = xQueueCreate(8, sizeof(rotary_encoder_event_t));
+
+   rotary_encoder_t enc = {.pin_a = PIN_A, .pin_b = PIN_B};
+   CHECK_EQ(rotary_encoder_init(queue), ESP_OK);
+   CHECK_EQ(rotary_encoder_add(&enc), ESP_OK);
+
+   // nothing to sample, the timer waits for the next step
+   mock_hal_advance(10 * POLL_US);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+
+   // edges faster than the polling interval are all decoded
+   replay(CW, 4, POLL_US / 4);
+   replay(CCW, 4, POLL_US / 4);
+   replay(CW, 4, POLL_US / 4);
+   mock_hal_advance(10 * POLL_US);
+   CHECK_EQ(next_dir(), ROT_CLOCKWISE);
+   CHECK_EQ(next_dir(), ROT_COUNTERCLOCKWISE);
+   CHECK_EQ(next_dir(), ROT_CLOCKWISE);
+   CHECK_EQ(next_dir(), 0);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+
+   // a glitch on B is ignored, and the pins sampled again by the next poll are back at rest
+   mock_hal_gpio_edge(PIN_B, 1);
+   mock_hal_advance(GLITCH_US / 4);
+   mock_hal_gpio_edge(PIN_B, 0);
+   mock_hal_advance(2 * POLL_US);
+   replay(CCW, 4, 2 * GLITCH_US);
+   mock_hal_advance(10 * POLL_US);
+   CHECK_EQ(next_dir(), ROT_COUNTERCLOCKWISE);
+   CHECK_EQ(next_dir(), 0);
+
+   // A rises inside the window after B, the next poll decodes it, so the cycle still steps
+   mock_hal_gpio_edge(PIN_B, 1);
+   mock_hal_advance(GLITCH_US / 4);
+   mock_hal_gpio_edge(PIN_A, 1);
+   mock_hal_advance(2 * POLL_US);
+   replay(CW + 2, 2, 2 * GLITCH_US);
+   mock_hal_advance(10 * POLL_US);
+   CHECK_EQ(next_dir(), ROT_CLOCKWISE);
+   CHECK_EQ(next_dir(), 0);
+   CHECK_EQ(mock_hal_timers_running(), 0);
+
+   CHECK_EQ(rotary_encoder_remove(&enc), ESP_OK);
+   CHECK_EQ(rotary_encoder_free(), ESP_OK);
+   vQueueDelete(queue);
+
+   return TEST_RESULT();
+}
@@ -0,0 +1,50 @@
+/*
+ * Lock waits of add/remove follow the polling interval of each engine, not the global default.
+ */
+#include <encoder.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+int main() {
+   mock_hal_reset();
+   QueueHandle_t btn_queue = xQueueCreate(1, sizeof(button_event_t));
+   QueueHandle_t enc_queue = xQueueCreate(1, sizeof(rotary_encoder_event_t));
+
+   button_t btn = {.pin = 4};
+   rotary_encoder_t enc = {.pin_a = 5, .pin_b = 6};
+
+   // default engines, one interval rounded up to ticks plus a tick
+   CHECK_EQ(button_init(btn_queue), ESP_OK);
+   CHECK_EQ(button_add(&btn), ESP_OK);
+   CHECK_EQ(mock_hal_mutex_wait, pdMS_TO_TICKS(CONFIG_EBTN_POLLING_INTERVAL_MS_BTN) + 1);
+   CHECK_EQ(button_remove(&btn), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+
+   CHECK_EQ(rotary_encoder_init(enc_queue), ESP_OK);
+   CHECK_EQ(rotary_encoder_add(&enc), ESP_OK);
+   CHECK_EQ(mock_hal_mutex_wait, pdMS_TO_TICKS((CONFIG_EBTN_POLLING_INTERVAL_US_ENC + 999) / 1000) + 1);
+   CHECK_EQ(rotary_encoder_remove(&enc), ESP_OK);
+   CHECK_EQ(rotary_encoder_free(), ESP_OK);
+
+   // engines with longer intervals wait longer
+   button_engine_t* btn_engine;
+   const button_engine_config_t btn_config = {.queue = btn_queue, .interval_us = 200000};
+   CHECK_EQ(button_engine_create(&btn_config, &btn_engine), ESP_OK);
+   CHECK_EQ(button_engine_add(btn_engine, &btn), ESP_OK);
+   CHECK_EQ(mock_hal_mutex_wait, pdMS_TO_TICKS(200) + 1);
+   CHECK_EQ(button_engine_remove(btn_engine, &btn), ESP_OK);
+   CHECK_EQ(button_engine_delete(btn_engine), ESP_OK);
+
+   rotary_encoder_engine_t* enc_engine;
+   const rotary_encoder_engine_config_t enc_config = {.queue = enc_queue, .interval_us = 50500};
+   CHECK_EQ(rotary_encoder_engine_create(&enc_config, &enc_engine), ESP_OK);
+   CHECK_EQ(rotary_encoder_engine_add(enc_engine, &enc), ESP_OK);
+   CHECK_EQ(mock_hal_mutex_wait, pdMS_TO_TICKS(51) + 1);
+   CHECK_EQ(rotary_encoder_engine_remove(enc_engine, &enc), ESP_OK);
+   CHECK_EQ(rotary_encoder_engine_delete(enc_engine), ESP_OK);
+
+   vQueueDelete(btn_queue);
+   vQueueDelete(enc_queue);
+   return TEST_RESULT();
+}
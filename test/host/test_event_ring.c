@@ -0,0 +1,166 @@
+/*
+ * Event ring overflow, built once per CONFIG_EBTN_EVENT_RING_OVERFLOW_* policy: a full ring fed directly checks drop counts
+ * and the order events come out in, then a button engine checks that a poll publishing only the held back event of the
+ * coalesce policy still notifies the consumer.
+ */
+#include <string.h>
+
+#include <button.h>
+
+#include "ebtn_ring.h"
+#include "mock_hal.h"
+#include "test.h"
+
+typedef struct {
+   uint8_t sender;
+   uint8_t type;
+   uint8_t count;
+} item_t;
+
+static bool merge(void* dst, const void* src) {
+   item_t* a = dst;
+   const item_t* b = src;
+
+   if (a->sender != b->sender || a->type != b->type)
+      return false;
+
+   *a = *b;
+   return true;
+}
+
+#define LENGTH 4
+
+static ebtn_ring_t ring;
+static item_t buf[LENGTH];
+static item_t overflow;
+
+static bool push(uint8_t sender, uint8_t type, uint8_t count) {
+   const item_t item = {sender, type, count};
+   return ebtn_ring_push(&ring, &item);
+}
+
+// items in the ring as "<sender><type><count>" separated by spaces, e.g. "0P1 1R1"
+static const char* drain() {
+   static char log[64];
+   size_t n = 0;
+
+   item_t item;
+   while (ebtn_ring_pop(&ring, &item, 1) && n + 5 < sizeof(log))
+      n += snprintf(log + n, sizeof(log) - n, n ? " %u%c%u" : "%u%c%u", item.sender, item.type, item.count);
+   log[n] = '\0';
+   return log;
+}
+
+#define CHECK_DRAIN(expected)                                                                                                                                  \
+   do {                                                                                                                                                        \
+      const char* log_ = drain();                                                                                                                              \
+      if (strcmp(log_, expected)) {                                                                                                                            \
+         fprintf(stderr, "%s:%d: ring \"%s\", expected \"%s\"\n", __FILE__, __LINE__, log_, expected);                                                         \
+         test_failures++;                                                                                                                                      \
+      }                                                                                                                                                        \
+   } while (0)
+
+#define DROPPED() atomic_load(&ring.dropped)
+
+static void test_overflow() {
+   ebtn_ring_init(&ring, buf, &overflow, sizeof(item_t), LENGTH, merge);
+
+   for (uint8_t i = 0; i < LENGTH; i++)
+      CHECK(push(i, 'P', 1));
+
+   // sender 9 pressed, released and pressed again while full
+#if CONFIG_EBTN_EVENT_RING_OVERFLOW_DROP_NEWEST
+   CHECK(!push(9, 'P', 1));
+   CHECK(!push(9, 'R', 1));
+   CHECK(!push(9, 'P', 2));
+   CHECK_EQ(DROPPED(), 3);
+   CHECK(!ebtn_ring_flush(&ring));
+   CHECK_DRAIN("0P1 1P1 2P1 3P1");
+#elif CONFIG_EBTN_EVENT_RING_OVERFLOW_DROP_OLDEST
+   CHECK(push(9, 'P', 1));
+   CHECK(push(9, 'R', 1));
+   CHECK(push(9, 'P', 2));
+   CHECK_EQ(DROPPED(), 3);
+   CHECK(!ebtn_ring_flush(&ring));
+   CHECK_DRAIN("3P1 9P1 9R1 9P2");
+#else
+   CHECK(push(9, 'P', 1)); // held back
+   CHECK(!push(9, 'R', 1));
+   CHECK(!push(9, 'P', 2)); // same type, but merging it would hide the release
+   CHECK_EQ(DROPPED(), 2);
+   CHECK(!ebtn_ring_flush(&ring)); // still full
+   CHECK_DRAIN("0P1 1P1 2P1 3P1");
+   CHECK(ebtn_ring_flush(&ring));
+   CHECK_DRAIN("9P1");
+
+   // events of the same sender and type that directly follow the held one are merged into it, others are discarded
+   for (uint8_t i = 0; i < LENGTH; i++)
+      CHECK(push(i, 'R', 1));
+   CHECK(push(9, 'C', 1));
+   CHECK(push(9, 'C', 2));
+   CHECK(!push(8, 'C', 1));
+   CHECK_EQ(DROPPED(), 3);
+   CHECK_DRAIN("0R1 1R1 2R1 3R1");
+
+   // the held event goes first, ahead of an event pushed once there is room
+   CHECK(push(7, 'P', 1));
+   CHECK_DRAIN("9C2 7P1");
+   CHECK(!ebtn_ring_flush(&ring));
+#endif
+}
+
+#define BUTTONS (LENGTH + 1)
+
+static void test_notify() {
+   mock_hal_reset();
+   button_t buttons[BUTTONS];
+
+   CHECK_EQ(button_init(NULL), ESP_OK);
+   button_events_set_consumer(xTaskGetCurrentTaskHandle());
+   for (int i = 0; i < BUTTONS; i++) {
+      buttons[i] = (button_t){.pin = i};
+      CHECK_EQ(button_add(&buttons[i]), ESP_OK);
+   }
+   mock_hal_advance(50000);
+   ulTaskNotifyTake(pdTRUE, 0);
+
+   // one more press than the ring holds, in a single poll
+   for (int i = 0; i < BUTTONS; i++)
+      mock_hal_level[i] = 1;
+   mock_hal_advance(CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000);
+   CHECK_EQ(ulTaskNotifyTake(pdTRUE, 0), 1);
+
+#if CONFIG_EBTN_EVENT_RING_OVERFLOW_DROP_OLDEST
+   const int first = 1; // the first press made room for the last
+#else
+   const int first = 0;
+#endif
+   button_event_t events[BUTTONS];
+   CHECK_EQ(button_events_drain(events, BUTTONS), LENGTH);
+   for (int i = 0; i < LENGTH; i++)
+      CHECK(events[i].sender == &buttons[first + i] && events[i].type == BUTTON_PRESSED);
+
+   // the next poll has nothing new, but publishes the held back press of the coalesce policy
+   mock_hal_advance(CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000);
+#if CONFIG_EBTN_EVENT_RING_OVERFLOW_COALESCE
+   CHECK_EQ(ulTaskNotifyTake(pdTRUE, 0), 1);
+   CHECK_EQ(button_events_drain(events, BUTTONS), 1);
+   CHECK(events[0].sender == &buttons[LENGTH] && events[0].type == BUTTON_PRESSED);
+   CHECK_EQ(button_events_dropped(), 0);
+#else
+   CHECK_EQ(ulTaskNotifyTake(pdTRUE, 0), 0);
+   CHECK_EQ(button_events_drain(events, BUTTONS), 0);
+   CHECK_EQ(button_events_dropped(), 1);
+#endif
+
+   for (int i = 0; i < BUTTONS; i++)
+      CHECK_EQ(button_remove(&buttons[i]), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+}
+
+int main() {
+   test_overflow();
+   test_notify();
+
+   return TEST_RESULT();
+}
@@ -0,0 +1,128 @@
+/*
+ * Pre-poll of a simulated port expander whose reads take a configurable time on the bus, read synchronously from the
+ * pre-poll callback or pipelined with ebtn_prepoll_async_t. Both must decode the same button events, and the timer task
+ * occupancy (time spent in polls per time elapsed) shows what each costs.
+ */
+#include <string.h>
+
+#include <button.h>
+
+#include "mock_hal.h"
+#include "test.h"
+
+#define BUTTONS 4
+#define INTERVAL_US (CONFIG_EBTN_POLLING_INTERVAL_MS_BTN * 1000)
+
+// Simulated expander: pins are mock_hal_level[0..BUTTONS), a read samples them once it completes after latency_us
+static uint32_t latency_us;
+static uint8_t* expander_dst;
+static uint8_t sync_data;
+static uint8_t async_data[2];
+
+static uint8_t expander_sample() {
+   uint8_t data = 0;
+   for (int i = 0; i < BUTTONS; i++)
+      data |= mock_hal_level[i] << i;
+   return data;
+}
+
+static void prepoll_sync() {
+   mock_hal_busy(latency_us); // the timer task waits for the whole transaction
+   sync_data = expander_sample();
+}
+
+static void expander_complete(void* arg) {
+   *expander_dst = expander_sample();
+   ebtn_prepoll_async_done(arg);
+}
+
+static void expander_start(ebtn_prepoll_async_t* prepoll, void* buf) {
+   expander_dst = buf;
+   mock_hal_schedule(latency_us, expander_complete, prepoll); // the bus works in the background
+}
+
+static ebtn_prepoll_async_t prepoll = {.start = expander_start, .buf = {&async_data[0], &async_data[1]}};
+static bool pipelined;
+
+static uint8_t poll_state(gpio_num_t pin) {
+   const uint8_t data = pipelined ? *(const uint8_t*)ebtn_prepoll_async_data(&prepoll) : sync_data;
+   return (data >> pin) & 1;
+}
+
+static QueueHandle_t queue;
+
+static int next_event(button_t** sender) {
+   button_event_t e;
+   if (!xQueueReceive(queue, &e, 0))
+      return -1;
+   *sender = e.sender;
+   return e.type;
+}
+
+// taps button 2 and returns the timer task occupancy in percent
+static double run(bool async, uint32_t latency) {
+   mock_hal_reset();
+   memset(&prepoll.internal, 0, sizeof(prepoll.internal));
+   memset(async_data, 0, sizeof(async_data));
+   sync_data = 0;
+   latency_us = latency;
+   pipelined = async;
+
+   button_t buttons[BUTTONS] = {0};
+   CHECK_EQ(button_init(queue), ESP_OK);
+   if (async) {
+      button_set_prepoll_async(&prepoll);
+   } else {
+      button_set_prepoll_callback(prepoll_sync);
+   }
+   for (int i = 0; i < BUTTONS; i++) {
+      buttons[i] = (button_t){.pin = i, .poll_state_callback = poll_state};
+      CHECK_EQ(button_add(&buttons[i]), ESP_OK);
+   }
+
+   mock_hal_advance(100000);
+   mock_hal_level[1] = 1;
+   mock_hal_advance(100000);
+   mock_hal_level[1] = 0;
+   mock_hal_advance(800000);
+
+   button_t* sender = NULL;
+   CHECK_EQ(next_event(&sender), BUTTON_PRESSED);
+   CHECK(sender == &buttons[1]);
+   CHECK_EQ(next_event(&sender), BUTTON_RELEASED);
+   CHECK_EQ(next_event(&sender), BUTTON_CLICKED);
+   CHECK_EQ(next_event(&sender), -1);
+
+   const double occupancy = 100.0 * mock_hal_timer_busy_us / mock_hal_now_us;
+
+   for (int i = 0; i < BUTTONS; i++)
+      CHECK_EQ(button_remove(&buttons[i]), ESP_OK);
+   button_set_prepoll_callback(NULL);
+   button_set_prepoll_async(NULL);
+   CHECK_EQ(button_free(), ESP_OK);
+   return occupancy;
+}
+
+int main() {
+   queue = xQueueCreate(8, sizeof(button_event_t));
+
+   static const uint32_t latencies[] = {50, 150, 1000, 5000};
+
+   printf("%11s %16s %16s\n", "latency us", "sync occupancy", "async occupancy");
+   for (size_t i = 0; i < sizeof(latencies) / sizeof(latencies[0]); i++) {
+      const double sync = run(false, latencies[i]);
+      const double async = run(true, latencies[i]);
+      printf("%11u %15.2f%% %15.2f%%\n", (unsigned)latencies[i], sync, async);
+
+      CHECK(sync > 90.0 * latencies[i] / INTERVAL_US); // every poll waits for the bus
+      CHECK(async == 0);                               // no poll waits for the bus
+      CHECK_EQ(prepoll.internal.overruns, 0);
+   }
+
+   // reads slower than the polling interval overrun every other poll and still decode, just later
+   run(true, INTERVAL_US * 3 / 2);
+   CHECK(prepoll.internal.overruns > 0);
+
+   vQueueDelete(queue);
+   return TEST_RESULT();
+}
@@ -0,0 +1,118 @@
+/*
+ * State snapshots: ids with a snapshot slot are unique across engines, and a reader copying snapshots while another
+ * thread publishes never sees a partial update.
+ */
+#include <pthread.h>
+
+#include <encoder.h>
+
+#include "ebtn_snapshot.h"
+#include "mock_hal.h"
+#include "test.h"
+
+static void test_ids() {
+   QueueHandle_t queue = xQueueCreate(8, sizeof(button_event_t));
+   button_engine_t* engine;
+   const button_engine_config_t config = {.queue = queue};
+   button_t btn = {.id = 1, .pin = 4};
+   button_t same_id = {.id = 1, .pin = 5};
+   button_t no_slot = {.id = 64, .pin = 6};
+   button_t no_slot_too = {.id = 64, .pin = 7};
+
+   CHECK_EQ(button_init(queue), ESP_OK);
+   CHECK_EQ(button_engine_create(&config, &engine), ESP_OK);
+   CHECK_EQ(button_add(&btn), ESP_OK);
+   CHECK_EQ(button_add(&btn), ESP_ERR_INVALID_STATE); // keeps its id
+   CHECK_EQ(button_engine_add(engine, &same_id), ESP_ERR_INVALID_ARG);
+   CHECK_EQ(button_add(&no_slot), ESP_OK);
+   CHECK_EQ(button_engine_add(engine, &no_slot_too), ESP_OK);
+
+   // free again once removed
+   CHECK_EQ(button_remove(&btn), ESP_OK);
+   CHECK_EQ(button_engine_add(engine, &same_id), ESP_OK);
+   CHECK_EQ(button_add(&btn), ESP_ERR_INVALID_ARG);
+
+   CHECK_EQ(button_engine_remove(engine, &same_id), ESP_OK);
+   CHECK_EQ(button_engine_remove(engine, &no_slot_too), ESP_OK);
+   CHECK_EQ(button_remove(&no_slot), ESP_OK);
+   CHECK_EQ(button_engine_delete(engine), ESP_OK);
+   CHECK_EQ(button_free(), ESP_OK);
+
+   rotary_encoder_engine_t* enc_engine;
+   const rotary_encoder_engine_config_t enc_config = {.queue = queue};
+   rotary_encoder_t enc = {.id = 1, .pin_a = 10, .pin_b = 11};
+   rotary_encoder_t enc_same_id = {.id = 1, .pin_a = 12, .pin_b = 13};
+
+   CHECK_EQ(rotary_encoder_init(queue), ESP_OK);
+   CHECK_EQ(rotary_encoder_engine_create(&enc_config, &enc_engine), ESP_OK);
+   CHECK_EQ(rotary_encoder_add(&enc), ESP_OK);
+   CHECK_EQ(rotary_encoder_engine_add(enc_engine, &enc_same_id), ESP_ERR_INVALID_ARG);
+   CHECK_EQ(rotary_encoder_remove(&enc), ESP_OK);
+   CHECK_EQ(rotary_encoder_engine_add(enc_engine, &enc_same_id), ESP_OK);
+   CHECK_EQ(rotary_encoder_engine_remove(enc_engine, &enc_same_id), ESP_OK);
+   CHECK_EQ(rotary_encoder_engine_delete(enc_engine), ESP_OK);
+   CHECK_EQ(rotary_encoder_free(), ESP_OK);
+
+   vQueueDelete(queue);
+}
+
+#define UPDATES 20000
+
+// widens the window a reader can copy a half written snapshot in
+static void spin() {
+   for (volatile int i = 0; i < 50; i++)
+      ;
+}
+
+// every update writes the same value to all fields one by one, so a consistent snapshot has them all equal
+static void* writer(void* arg) {
+   volatile uint32_t* pressed = (volatile uint32_t*)&ebtn_snapshot.pressed;
+   volatile int32_t* positions = ebtn_snapshot.positions;
+
+   for (uint32_t n = 1; n <= UPDATES; n++) {
+      ebtn_snapshot_write_begin();
+      pressed[0] = n;
+      spin();
+      for (int i = 0; i <= CONFIG_EBTN_SNAPSHOT_ENCODERS; i++) {
+         positions[i] = n;
+         spin();
+      }
+      pressed[1] = n;
+      ebtn_snapshot_write_end();
+      spin();
+   }
+   return NULL;
+}
+
+static void test_seqlock() {
+   pthread_t thread;
+   CHECK_EQ(pthread_create(&thread, NULL, writer, NULL), 0);
+
+   uint32_t last = 0;
+   int torn = 0;
+   int backwards = 0;
+   while (last < UPDATES) {
+      ebtn_snapshot_t snapshot;
+      ebtn_get_snapshot(&snapshot);
+
+      const uint32_t n = (uint32_t)snapshot.pressed;
+      torn += (snapshot.pressed >> 32) != n;
+      for (int i = 0; i <= CONFIG_EBTN_SNAPSHOT_ENCODERS; i++)
+         torn += snapshot.positions[i] != (int32_t)n;
+      backwards += n < last;
+      last = n;
+   }
+
+   pthread_join(thread, NULL);
+   CHECK_EQ(torn, 0);
+   CHECK_EQ(backwards, 0);
+}
+
+int main() {
+   mock_hal_reset();
+
+   test_ids();
+   test_seqlock();
+
+   return TEST_RESULT();
+}